@@ -0,0 +1,78 @@
+/**
+ * @file alu_ext.c
+ * @brief ALU for GameBoy Emulator, part formerly provided as a library
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include "alu_ext.h"
+#include "bit.h"
+#include "error.h"
+
+static void set_output(alu_output_t* output, uint8_t value, int z, int n, int h, int c)
+{
+    output->value = value;
+    output->flags = 0;
+    if (z) {
+        set_Z(&output->flags);
+    }
+    if (n) {
+        set_N(&output->flags);
+    }
+    if (h) {
+        set_H(&output->flags);
+    }
+    if (c) {
+        set_C(&output->flags);
+    }
+}
+
+int alu_bcd_adjust(alu_output_t* result)
+{
+    M_REQUIRE_NON_NULL(result);
+
+    const flags_t flags = result->flags;
+    const uint8_t value = lsb8(result->value);
+
+    // the previous operation tells which digits overflowed (H: low, C: high)
+    const bit_t fix_msb = get_C(flags) || (!get_N(flags) && value > 0x99);
+    const bit_t fix_lsb = get_H(flags) || (!get_N(flags) && lsb4(value) > 9);
+    const uint8_t fix = (uint8_t)(0x60 * fix_msb + 0x06 * fix_lsb);
+
+    const uint8_t adjusted = get_N(flags) ? (uint8_t)(value - fix) : (uint8_t)(value + fix);
+    set_output(result, adjusted, adjusted == 0, get_N(flags), 0, fix_msb);
+    return ERR_NONE;
+}
+
+int alu_and(alu_output_t* result, uint8_t x, uint8_t y)
+{
+    M_REQUIRE_NON_NULL(result);
+    const uint8_t value = x & y;
+    set_output(result, value, value == 0, 0, 1, 0);
+    return ERR_NONE;
+}
+
+int alu_or(alu_output_t* result, uint8_t x, uint8_t y)
+{
+    M_REQUIRE_NON_NULL(result);
+    const uint8_t value = x | y;
+    set_output(result, value, value == 0, 0, 0, 0);
+    return ERR_NONE;
+}
+
+int alu_xor(alu_output_t* result, uint8_t x, uint8_t y)
+{
+    M_REQUIRE_NON_NULL(result);
+    const uint8_t value = x ^ y;
+    set_output(result, value, value == 0, 0, 0, 0);
+    return ERR_NONE;
+}
+
+int alu_swap4(alu_output_t* result, uint8_t x)
+{
+    M_REQUIRE_NON_NULL(result);
+    bit_rotate(&x, LEFT, 4);
+    set_output(result, x, x == 0, 0, 0, 0);
+    return ERR_NONE;
+}
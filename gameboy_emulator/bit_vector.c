@@ -12,6 +12,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BIT_VECTOR_SIMD
+#include <immintrin.h>
+#endif
+
 #define CHUNK_SIZE 32
 
 static size_t get_chunk_count(size_t size)
@@ -19,6 +24,146 @@ static size_t get_chunk_count(size_t size)
     return (size % CHUNK_SIZE) ? size / CHUNK_SIZE + 1 : size / CHUNK_SIZE;
 }
 
+// ======================================================================
+/*
+ * Kernels of the logical operations on chunk arrays, in scalar, SSE2 and
+ * AVX2 versions. The best version supported by the CPU is selected once
+ * at load time; the scalar ones are used until then and on other targets.
+ */
+typedef void (*chunks_unary_t)(uint32_t* dst, size_t count);
+typedef void (*chunks_binary_t)(uint32_t* dst, const uint32_t* src, size_t count);
+
+#define DEFINE_SCALAR_KERNEL(name, op) \
+    static void chunks_##name##_scalar(uint32_t* dst, const uint32_t* src, size_t count) \
+    { \
+        for (size_t i = 0; i < count; i++) \
+        { \
+            dst[i] op##= src[i]; \
+        } \
+    }
+
+static void chunks_not_scalar(uint32_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[i] = ~dst[i];
+    }
+}
+
+DEFINE_SCALAR_KERNEL(and, &)
+DEFINE_SCALAR_KERNEL(or, |)
+DEFINE_SCALAR_KERNEL(xor, ^)
+
+static struct {
+    chunks_unary_t not;
+    chunks_binary_t and;
+    chunks_binary_t or;
+    chunks_binary_t xor;
+} kernels = { chunks_not_scalar, chunks_and_scalar, chunks_or_scalar, chunks_xor_scalar };
+
+#ifdef BIT_VECTOR_SIMD
+// vectors of width (in chunks) chunks, then the remaining chunks with the tail kernels
+// (AVX2 falls back to SSE2: a scanline of 160 bits is 5 chunks, less than an AVX2 vector)
+#define DEFINE_SIMD_KERNELS(isa, isa_name, tail, vec, width, load, store, set1, and_op, or_op, xor_op) \
+    __attribute__((target(isa_name))) \
+    static void chunks_not_##isa(uint32_t* dst, size_t count) \
+    { \
+        const vec ones = set1(-1); \
+        size_t i = 0; \
+        for (; i + width <= count; i += width) \
+        { \
+            store((vec*) (dst + i), xor_op(load((const vec*) (dst + i)), ones)); \
+        } \
+        chunks_not_##tail(dst + i, count - i); \
+    } \
+    DEFINE_SIMD_BINARY_KERNEL(and, isa, isa_name, tail, vec, width, load, store, and_op) \
+    DEFINE_SIMD_BINARY_KERNEL(or, isa, isa_name, tail, vec, width, load, store, or_op) \
+    DEFINE_SIMD_BINARY_KERNEL(xor, isa, isa_name, tail, vec, width, load, store, xor_op)
+
+#define DEFINE_SIMD_BINARY_KERNEL(name, isa, isa_name, tail, vec, width, load, store, op) \
+    __attribute__((target(isa_name))) \
+    static void chunks_##name##_##isa(uint32_t* dst, const uint32_t* src, size_t count) \
+    { \
+        size_t i = 0; \
+        for (; i + width <= count; i += width) \
+        { \
+            store((vec*) (dst + i), op(load((const vec*) (dst + i)), load((const vec*) (src + i)))); \
+        } \
+        chunks_##name##_##tail(dst + i, src + i, count - i); \
+    }
+
+DEFINE_SIMD_KERNELS(sse2, "sse2", scalar, __m128i, 4, _mm_loadu_si128, _mm_storeu_si128, _mm_set1_epi32,
+                    _mm_and_si128, _mm_or_si128, _mm_xor_si128)
+DEFINE_SIMD_KERNELS(avx2, "avx2", sse2, __m256i, 8, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_set1_epi32,
+                    _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256)
+
+__attribute__((constructor))
+static void select_kernels(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.not = chunks_not_avx2;
+        kernels.and = chunks_and_avx2;
+        kernels.or = chunks_or_avx2;
+        kernels.xor = chunks_xor_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        kernels.not = chunks_not_sse2;
+        kernels.and = chunks_and_sse2;
+        kernels.or = chunks_or_sse2;
+        kernels.xor = chunks_xor_sse2;
+    }
+}
+#endif
+
+// ======================================================================
+/*
+ * Pool of the freed vectors of up to 256 bits (the lines of the image pipeline
+ * are 160 or 256 bits long), in free lists per size class of 1, 2, 4 and 8
+ * chunks, reused by the next allocations of the class instead of malloc.
+ * Larger vectors are allocated and freed directly. The lists are per thread,
+ * so that no locking is needed; a vector may still be freed by any thread.
+ */
+typedef struct pool_block {
+    struct pool_block *next;
+} pool_block_t;
+
+static _Thread_local struct {
+    pool_block_t *head;
+    size_t count;
+} pool[BIT_VECTOR_POOL_CLASSES];
+
+// size class of a vector of chunk_count chunks, -1 if it is not pooled
+static int get_size_class(size_t chunk_count)
+{
+    int size_class = 0;
+    while ((size_t) 1 << size_class < chunk_count)
+    {
+        size_class++;
+    }
+    return size_class < BIT_VECTOR_POOL_CLASSES ? size_class : -1;
+}
+
+static bit_vector_t *bit_vector_alloc(size_t chunk_count)
+{
+    int size_class = get_size_class(chunk_count);
+    if (size_class < 0)
+    {
+        return malloc(sizeof(bit_vector_t) + chunk_count * sizeof(uint32_t));
+    }
+
+    pool_block_t *block = pool[size_class].head;
+    if (block)
+    {
+        pool[size_class].head = block->next;
+        pool[size_class].count--;
+        return (bit_vector_t *) block;
+    }
+    return malloc(sizeof(bit_vector_t) + ((size_t) 1 << size_class) * sizeof(uint32_t));
+}
+
 bit_vector_t *bit_vector_create(size_t size, bit_t value)
 {
     if (size == 0)
@@ -27,7 +172,7 @@ bit_vector_t *bit_vector_create(size_t size, bit_t value)
     }
 
     size_t chunk_count = get_chunk_count(size);
-    bit_vector_t *pbv = malloc(sizeof(bit_vector_t) + chunk_count * sizeof(uint32_t));
+    bit_vector_t *pbv = bit_vector_alloc(chunk_count);
     if (!pbv)
     {
         return NULL;
@@ -53,8 +198,8 @@ bit_vector_t *bit_vector_cpy(const bit_vector_t *pbv)
         return NULL;
     }
 
-    uint32_t chunk_count = get_chunk_count(pbv->size);
-    bit_vector_t *new_pbv = malloc(sizeof(bit_vector_t) + chunk_count * sizeof(uint32_t));
+    size_t chunk_count = get_chunk_count(pbv->size);
+    bit_vector_t *new_pbv = bit_vector_alloc(chunk_count);
     if (!new_pbv)
     {
         return NULL;
@@ -85,13 +230,10 @@ bit_vector_t *bit_vector_not(bit_vector_t *pbv)
     }
 
     size_t chunk_count = get_chunk_count(pbv->size);
-    for (size_t i = 0; i < chunk_count - 1; i++)
-    {
-        pbv->content[i] = ~pbv->content[i];
-    }
+    kernels.not(pbv->content, chunk_count);
     size_t last_chunk_idx = pbv->size % CHUNK_SIZE;
     uint32_t last_chunk_mask = last_chunk_idx == 0 ? ~0 : ((1 << last_chunk_idx) - 1);
-    pbv->content[chunk_count - 1] = last_chunk_mask & ~pbv->content[chunk_count - 1];
+    pbv->content[chunk_count - 1] &= last_chunk_mask;
 
     return pbv;
 }
@@ -103,11 +245,7 @@ bit_vector_t *bit_vector_and(bit_vector_t *pbv1, const bit_vector_t *pbv2)
         return NULL;
     }
 
-    size_t chunk_count = get_chunk_count(pbv1->size);
-    for (size_t i = 0; i < chunk_count; i++)
-    {
-        pbv1->content[i] &= pbv2->content[i];
-    }
+    kernels.and(pbv1->content, pbv2->content, get_chunk_count(pbv1->size));
 
     return pbv1;
 }
@@ -119,11 +257,7 @@ bit_vector_t *bit_vector_or(bit_vector_t *pbv1, const bit_vector_t *pbv2)
         return NULL;
     }
 
-    size_t chunk_count = get_chunk_count(pbv1->size);
-    for (size_t i = 0; i < chunk_count; i++)
-    {
-        pbv1->content[i] |= pbv2->content[i];
-    }
+    kernels.or(pbv1->content, pbv2->content, get_chunk_count(pbv1->size));
 
     return pbv1;
 }
@@ -135,11 +269,7 @@ bit_vector_t *bit_vector_xor(bit_vector_t *pbv1, const bit_vector_t *pbv2)
         return NULL;
     }
 
-    size_t chunk_count = get_chunk_count(pbv1->size);
-    for (size_t i = 0; i < chunk_count; i++)
-    {
-        pbv1->content[i] ^= pbv2->content[i];
-    }
+    kernels.xor(pbv1->content, pbv2->content, get_chunk_count(pbv1->size));
 
     return pbv1;
 }
@@ -149,17 +279,7 @@ uint32_t combine(uint32_t v1, uint32_t v2, size_t index)
     return v1 >> index || v2 << (CHUNK_SIZE - index);
 }
 
-static uint32_t bit_vector_get_chunk(const bit_vector_t *pbv, int64_t chunk, bool wrap) {
-    if (wrap)
-    {
-        uint32_t val = 0;
-        for (uint32_t bp = 32; bp > 0; bp--)
-        {
-            val = (val << 1) | bit_vector_get(pbv, (CHUNK_SIZE * chunk + bp - 1) % pbv->size);
-        }
-        return val;
-    }
-
+static uint32_t bit_vector_get_chunk(const bit_vector_t *pbv, int64_t chunk) {
     int64_t chunk_count = get_chunk_count(pbv->size);
     if (chunk >= 0 && chunk < chunk_count)
     {
@@ -168,21 +288,56 @@ static uint32_t bit_vector_get_chunk(const bit_vector_t *pbv, int64_t chunk, boo
     return 0;
 }
 
+static uint32_t bit_vector_extract_chunk_zero(const bit_vector_t *pbv, int64_t index) {
+    int64_t chunk = index >> 5;
+    uint32_t chunk_index = (index % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
+
+    // a single shift of the 64-bit window made of the two overlapped chunks
+    uint64_t window = (uint64_t) bit_vector_get_chunk(pbv, chunk + 1) << CHUNK_SIZE |
+        bit_vector_get_chunk(pbv, chunk);
+    return (uint32_t) (window >> chunk_index);
+}
+
+static uint32_t bit_vector_extract_chunk_wrap(const bit_vector_t *pbv, int64_t index) {
+    const int64_t size = pbv->size;
+    int64_t start = (index % size + size) % size;
+
+    // runs of the bits up to the end of the vector, restarting from its beginning
+    // (at most two runs, unless the vector is shorter than a chunk)
+    uint32_t val = 0;
+    for (int64_t done = 0; done < CHUNK_SIZE; done += size - start, start = 0)
+    {
+        uint32_t run = bit_vector_extract_chunk_zero(pbv, start);
+        if (size - start < CHUNK_SIZE)
+        {
+            run &= (UINT32_C(1) << (size - start)) - 1;
+        }
+        val |= run << done;
+    }
+    return val;
+}
+
 static uint32_t bit_vector_extract_chunk(const bit_vector_t *pbv, int64_t index, bool wrap) {
     if (!pbv)
     {
         return 0;
     }
 
-    int64_t chunk = index >> 5;
-    uint32_t chunk_index = (index % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
-    if (chunk_index == 0)
+    return wrap ? bit_vector_extract_chunk_wrap(pbv, index) : bit_vector_extract_chunk_zero(pbv, index);
+}
+
+static bit_vector_t *bit_vector_extract_into(bit_vector_t *dst, const bit_vector_t *pbv, int64_t index, bool wrap)
+{
+    size_t chunk_count = get_chunk_count(dst->size);
+    for (size_t i = 0; i < chunk_count - 1; i++)
     {
-        return bit_vector_get_chunk(pbv, chunk, wrap);
+        dst->content[i] = bit_vector_extract_chunk(pbv, index + CHUNK_SIZE * i, wrap);
     }
+    size_t last_chunk_idx = dst->size % CHUNK_SIZE;
+    uint32_t last_chunk_mask = last_chunk_idx == 0 ? ~0 : ((1 << last_chunk_idx) - 1);
+    dst->content[chunk_count - 1] = last_chunk_mask & bit_vector_extract_chunk(pbv, index + CHUNK_SIZE * (chunk_count - 1), wrap);
 
-    return (bit_vector_get_chunk(pbv, chunk + 1, wrap) << (CHUNK_SIZE - chunk_index)) |
-        (bit_vector_get_chunk(pbv, chunk, wrap) >> chunk_index);
+    return dst;
 }
 
 static bit_vector_t *bit_vector_extract(const bit_vector_t *pbv, int64_t index, size_t size, bool wrap)
@@ -192,23 +347,14 @@ static bit_vector_t *bit_vector_extract(const bit_vector_t *pbv, int64_t index,
         return NULL;
     }
 
-    size_t chunk_count = get_chunk_count(size);
-    bit_vector_t *new_pbv = malloc(sizeof(bit_vector_t) + chunk_count * sizeof(uint32_t));
+    bit_vector_t *new_pbv = bit_vector_alloc(get_chunk_count(size));
     if (!new_pbv)
     {
         return NULL;
     }
 
     new_pbv->size = size;
-    for (size_t i = 0; i < chunk_count - 1; i++)
-    {
-        new_pbv->content[i] = bit_vector_extract_chunk(pbv, index + CHUNK_SIZE * i, wrap);
-    }
-    size_t last_chunk_idx = size % CHUNK_SIZE;
-    uint32_t last_chunk_mask = last_chunk_idx == 0 ? ~0 : ((1 << last_chunk_idx) - 1);
-    new_pbv->content[chunk_count - 1] = last_chunk_mask & bit_vector_extract_chunk(pbv, index + CHUNK_SIZE * (chunk_count - 1), wrap);
-
-    return new_pbv;
+    return bit_vector_extract_into(new_pbv, pbv, index, wrap);
 }
 
 bit_vector_t *bit_vector_extract_zero_ext(const bit_vector_t *pbv, int64_t index, size_t size)
@@ -216,6 +362,16 @@ bit_vector_t *bit_vector_extract_zero_ext(const bit_vector_t *pbv, int64_t index
     return bit_vector_extract(pbv, index, size, false);
 }
 
+bit_vector_t *bit_vector_extract_zero_ext_into(bit_vector_t *dst, const bit_vector_t *pbv, int64_t index)
+{
+    if (!dst || dst == pbv)
+    {
+        return NULL;
+    }
+
+    return bit_vector_extract_into(dst, pbv, index, false);
+}
+
 bit_vector_t *bit_vector_extract_wrap_ext(const bit_vector_t *pbv, int64_t index, size_t size)
 {
     if (!pbv)
@@ -226,6 +382,16 @@ bit_vector_t *bit_vector_extract_wrap_ext(const bit_vector_t *pbv, int64_t index
     return bit_vector_extract(pbv, index, size, true);
 }
 
+bit_vector_t *bit_vector_extract_wrap_ext_into(bit_vector_t *dst, const bit_vector_t *pbv, int64_t index)
+{
+    if (!dst || !pbv || dst == pbv)
+    {
+        return NULL;
+    }
+
+    return bit_vector_extract_into(dst, pbv, index, true);
+}
+
 bit_vector_t *bit_vector_shift(const bit_vector_t* pbv, int64_t shift)
 {
     if (!pbv)
@@ -236,34 +402,73 @@ bit_vector_t *bit_vector_shift(const bit_vector_t* pbv, int64_t shift)
     return bit_vector_extract_zero_ext(pbv, -shift, pbv->size);
 }
 
+bit_vector_t *bit_vector_shift_into(bit_vector_t *dst, const bit_vector_t *pbv, int64_t shift)
+{
+    if (!dst || !pbv || dst->size != pbv->size)
+    {
+        return NULL;
+    }
+
+    return bit_vector_extract_zero_ext_into(dst, pbv, -shift);
+}
+
 bit_vector_t* bit_vector_join(const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift)
 {
-    if (!pbv1 || !pbv2 || pbv1->size != pbv2->size || shift < 0)
+    if (!pbv1 || !pbv2)
     {
         return NULL;
     }
 
-    if (shift > (int64_t)pbv1->size)
+    bit_vector_t *new_pbv = bit_vector_alloc(get_chunk_count(pbv1->size));
+    if (!new_pbv)
+    {
+        return NULL;
+    }
+    new_pbv->size = pbv1->size;
+
+    if (!bit_vector_join_into(new_pbv, pbv1, pbv2, shift))
+    {
+        bit_vector_free(&new_pbv);
+    }
+    return new_pbv;
+}
+
+bit_vector_t* bit_vector_join_into(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift)
+{
+    if (!dst || !pbv1 || !pbv2 || pbv1->size != pbv2->size || dst->size != pbv1->size || shift < 0)
     {
         return NULL;
     }
 
-    bit_vector_t *ones = bit_vector_create(pbv1->size, 1);
-    // décalage à droite de (total_bits - shift) pour obtenir un mask avec les shift LSB à 1 et les autres bits à 0
-    bit_vector_t *mask1 = bit_vector_shift(ones, shift - pbv1->size);
-    // décalage à gauche de shift pour obtenir un mask avec les (total_bits - shift) LSB à 0 et les autres bits à 1
-    bit_vector_t *mask2 = bit_vector_shift(ones, shift);
-    // on peut libérer la mémoire du vecteur que l'on a créé précedemment
-    bit_vector_free(&ones);
+    if (shift > (int64_t)pbv1->size)
+    {
+        return NULL;
+    }
 
-    mask1 = bit_vector_and(mask1, pbv1);
-    mask2 = bit_vector_and(mask2, pbv2);
+    // whole chunks of pbv1, the chunk containing the shift, whole chunks of pbv2
+    // (chunk by chunk, dst being possibly one of them)
+    size_t chunk_count = get_chunk_count(pbv1->size);
+    size_t split = (size_t) shift / CHUNK_SIZE;
+    uint32_t mask = (UINT32_C(1) << (shift % CHUNK_SIZE)) - 1;
+    for (size_t i = 0; i < chunk_count; i++)
+    {
+        dst->content[i] = i < split ? pbv1->content[i] :
+                          i > split ? pbv2->content[i] :
+                          (pbv1->content[i] & mask) | (pbv2->content[i] & ~mask);
+    }
 
-    mask1 = bit_vector_or(mask1, mask2);
+    return dst;
+}
 
-    bit_vector_free(&mask2);
+bit_vector_t *bit_vector_cpy_into(bit_vector_t *dst, const bit_vector_t *pbv)
+{
+    if (!dst || !pbv || dst->size != pbv->size)
+    {
+        return NULL;
+    }
 
-    return mask1;
+    memmove(dst->content, pbv->content, get_chunk_count(pbv->size) * sizeof(uint32_t));
+    return dst;
 }
 
 int bit_vector_print(const bit_vector_t *pbv)
@@ -297,6 +502,34 @@ int bit_vector_println(const char *prefix, const bit_vector_t *pbv)
 
 void bit_vector_free(bit_vector_t **pbv)
 {
-    free(*pbv);
+    if (*pbv)
+    {
+        int size_class = get_size_class(get_chunk_count((*pbv)->size));
+        if (size_class >= 0 && pool[size_class].count < BIT_VECTOR_POOL_MAX_FREE)
+        {
+            pool_block_t *block = (pool_block_t *) *pbv;
+            block->next = pool[size_class].head;
+            pool[size_class].head = block;
+            pool[size_class].count++;
+        }
+        else
+        {
+            free(*pbv);
+        }
+    }
     *pbv = NULL;
 }
+
+void bit_vector_pool_reset(void)
+{
+    for (int size_class = 0; size_class < BIT_VECTOR_POOL_CLASSES; size_class++)
+    {
+        while (pool[size_class].head)
+        {
+            pool_block_t *block = pool[size_class].head;
+            pool[size_class].head = block->next;
+            free(block);
+        }
+        pool[size_class].count = 0;
+    }
+}
@@ -17,6 +17,11 @@ extern "C" {
 #include <stddef.h> // for size_t
 #include <stdint.h>
 
+// Number of size classes of the vector pool (vectors of up to 2^(N-1) chunks of 32 bits)
+#define BIT_VECTOR_POOL_CLASSES 4
+// Maximal number of freed vectors kept by the pool, per size class and per thread
+#define BIT_VECTOR_POOL_MAX_FREE 1024
+
 //=========================================================================
 /**
  * @brief Type to represent image lines
@@ -44,6 +49,15 @@ bit_vector_t* bit_vector_create(size_t size, bit_t value);
  */
 bit_vector_t* bit_vector_cpy(const bit_vector_t* pbv);
 
+//=========================================================================
+/**
+ * @brief Copy a bit vector into another one of the same size
+ * @param dst pointer to the bit vector to write
+ * @param pbv pointer to the bit vector to copy
+ * @return dst (NULL in case of error)
+ */
+bit_vector_t* bit_vector_cpy_into(bit_vector_t* dst, const bit_vector_t* pbv);
+
 //=========================================================================
 /**
  * @brief Get the value of a given bit in a bit vector
@@ -98,6 +112,16 @@ bit_vector_t* bit_vector_xor(bit_vector_t* pbv1, const bit_vector_t* pbv2);
  */
 bit_vector_t* bit_vector_extract_zero_ext(const bit_vector_t* pbv, int64_t index, size_t size);
 
+//=========================================================================
+/**
+ * @brief Extract a bit vector (zero extended) into an existing one
+ * @param dst pointer to the bit vector to write, of the size to extract (not pbv)
+ * @param pbv pointer to bit vector
+ * @param index index from where to start extraction
+ * @return dst (NULL in case of error)
+ */
+bit_vector_t* bit_vector_extract_zero_ext_into(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index);
+
 //=========================================================================
 /**
  * @brief Create a new bit vector extracted from another bit vector (wrap extended)
@@ -108,6 +132,16 @@ bit_vector_t* bit_vector_extract_zero_ext(const bit_vector_t* pbv, int64_t index
  */
 bit_vector_t* bit_vector_extract_wrap_ext(const bit_vector_t* pbv, int64_t index, size_t size);
 
+//=========================================================================
+/**
+ * @brief Extract a bit vector (wrap extended) into an existing one
+ * @param dst pointer to the bit vector to write, of the size to extract (not pbv)
+ * @param pbv pointer to bit vector
+ * @param index index from where to start extraction
+ * @return dst (NULL in case of error)
+ */
+bit_vector_t* bit_vector_extract_wrap_ext_into(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index);
+
 //=========================================================================
 /**
  * @brief Create a new bit vector shifted from another bit vector
@@ -117,6 +151,16 @@ bit_vector_t* bit_vector_extract_wrap_ext(const bit_vector_t* pbv, int64_t index
  */
 bit_vector_t* bit_vector_shift(const bit_vector_t* pbv, int64_t shift);
 
+//=========================================================================
+/**
+ * @brief Shift a bit vector into an existing one
+ * @param dst pointer to the bit vector to write, of the size of pbv (not pbv)
+ * @param pbv pointer to bit vector
+ * @param shift bit shift count
+ * @return dst (NULL in case of error)
+ */
+bit_vector_t* bit_vector_shift_into(bit_vector_t* dst, const bit_vector_t* pbv, int64_t shift);
+
 //=========================================================================
 /**
  * @brief Join two bit vectors into a new bit vector
@@ -127,6 +171,17 @@ bit_vector_t* bit_vector_shift(const bit_vector_t* pbv, int64_t shift);
  */
 bit_vector_t* bit_vector_join(const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift);
 
+//=========================================================================
+/**
+ * @brief Join two bit vectors into an existing one
+ * @param dst pointer to the bit vector to write, of the size of pbv1 (may be pbv1 or pbv2)
+ * @param pbv1 pointer to first bit vector
+ * @param pbv2 pointer to second bit vector
+ * @param shift bit shift count
+ * @return dst (NULL in case of error)
+ */
+bit_vector_t* bit_vector_join_into(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift);
+
 //=========================================================================
 /**
  * @brief Print bit vector values
@@ -151,6 +206,14 @@ int bit_vector_println(const char* prefix, const bit_vector_t* pbv);
  */
 void bit_vector_free(bit_vector_t** pbv);
 
+//=========================================================================
+/**
+ * @brief Releases the freed vectors kept for reuse by the calling thread.
+ *        Vectors in use are not affected. Can be called once per frame
+ *        to bound the memory kept by the pool to what a frame needs.
+ */
+void bit_vector_pool_reset(void);
+
 #ifdef __cplusplus
 }
 #endif
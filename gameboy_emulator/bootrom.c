@@ -9,6 +9,7 @@
 #include "bootrom.h"
 #include "error.h"
 #include "cartridge.h"
+#include "timeline.h"
 
 int bootrom_init(component_t* c)
 {
@@ -28,6 +29,7 @@ int bootrom_bus_listener(gameboy_t* gameboy, addr_t addr)
         M_REQUIRE_NO_ERR(bus_unplug(gameboy->bus, &gameboy->bootrom));
         M_REQUIRE_NO_ERR(cartridge_plug(&gameboy->cartridge, gameboy->bus));
         gameboy->boot = 0;
+        timeline_instant("bootrom disabled", "core");
     }
 
     return ERR_NONE;
@@ -9,6 +9,9 @@
 #include "bus.h"
 #include "bit.h"
 #include "error.h"
+#include "heatmap.h"
+
+#include <string.h>
 
 int bus_remap(bus_t bus, component_t *c, addr_t offset)
 {
@@ -90,6 +93,7 @@ int bus_unplug(bus_t bus, component_t *c)
 int bus_read(const bus_t bus, addr_t address, data_t* data)
 {
     M_REQUIRE_NON_NULL(data);
+    heatmap_read(address);
 
     if (bus[address] == NULL)
     {
@@ -102,9 +106,96 @@ int bus_read(const bus_t bus, addr_t address, data_t* data)
     return ERR_NONE;
 }
 
+/**
+ * @brief Length (up to max) of the range from start which is either unmapped,
+ *        or mapped to contiguous bytes, without wrapping around
+ */
+static size_t bus_range(const bus_t bus, addr_t start, size_t max)
+{
+    size_t length = 1;
+    if (NULL == bus[start])
+    {
+        while (length < max && start + length < BUS_SIZE && NULL == bus[start + length])
+        {
+            length++;
+        }
+    }
+    else
+    {
+        while (length < max && start + length < BUS_SIZE && bus[start] + length == bus[start + length])
+        {
+            length++;
+        }
+    }
+    return length;
+}
+
+int bus_read_block(const bus_t bus, addr_t address, data_t* data, size_t size)
+{
+    M_REQUIRE_NON_NULL(data);
+    M_REQUIRE(size <= BUS_SIZE, ERR_BAD_PARAMETER, "Block of %zu bytes larger than the bus", size);
+
+    size_t done = 0;
+    while (done < size)
+    {
+        const addr_t start = (addr_t)(address + done);
+        const size_t length = bus_range(bus, start, size - done);
+        #ifdef HEATMAP
+        for (size_t i = 0; i < length; i++)
+        {
+            heatmap_read((addr_t)(start + i));
+        }
+        #endif
+
+        if (NULL == bus[start])
+        {
+            memset(data + done, NULL_DATA, length);
+        }
+        else
+        {
+            memcpy(data + done, bus[start], length);
+        }
+        done += length;
+    }
+    return ERR_NONE;
+}
+
+int bus_write_block(bus_t bus, addr_t address, const data_t* data, size_t size)
+{
+    M_REQUIRE_NON_NULL(data);
+    M_REQUIRE(size <= BUS_SIZE, ERR_BAD_PARAMETER, "Block of %zu bytes larger than the bus", size);
+
+    // as bus_write, fails on unmapped addresses, but before writing anything
+    for (size_t done = 0; done < size; )
+    {
+        const addr_t start = (addr_t)(address + done);
+        M_REQUIRE_NON_NULL(bus[start]);
+        done += bus_range(bus, start, size - done);
+    }
+
+    size_t done = 0;
+    while (done < size)
+    {
+        const addr_t start = (addr_t)(address + done);
+        const size_t length = bus_range(bus, start, size - done);
+        #ifdef HEATMAP
+        for (size_t i = 0; i < length; i++)
+        {
+            heatmap_write((addr_t)(start + i));
+        }
+        #endif
+
+        memcpy(bus[start], data + done, length);
+        done += length;
+    }
+    return ERR_NONE;
+}
+
 int bus_read16(const bus_t bus, addr_t address, addr_t* data16)
 {
     M_REQUIRE_NON_NULL(data16);
+    heatmap_read(address);
+    heatmap_read((addr_t)(address + 1));
 
     if (bus[address] == NULL)
     {
@@ -120,6 +211,7 @@ int bus_read16(const bus_t bus, addr_t address, addr_t* data16)
 int bus_write(bus_t bus, addr_t address, data_t data)
 {
     M_REQUIRE_NON_NULL(bus[address]);
+    heatmap_write(address);
     
     *bus[address] = data;
     return ERR_NONE;
@@ -128,6 +220,8 @@ int bus_write(bus_t bus, addr_t address, data_t data)
 int bus_write16(bus_t bus, addr_t address, addr_t data16)
 {
     M_REQUIRE_NON_NULL(bus[address]);
+    heatmap_write(address);
+    heatmap_write((addr_t)(address + 1));
         
     data_t first_byte = lsb8(data16);
     *bus[address] = first_byte;
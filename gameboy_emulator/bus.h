@@ -85,6 +85,19 @@ int bus_unplug(bus_t bus, component_t* c);
 int bus_read(const bus_t bus, addr_t address, data_t* data);
 
 
+/**
+ * @brief Read a block of the bus: each contiguous range of a component
+ *        is copied at once, the unmapped addresses read as NULL_DATA
+ *
+ * @param bus bus to read from
+ * @param address address of the first byte to read
+ * @param data pointer to write the read bytes to
+ * @param size number of bytes to read (the addresses wrapping around)
+ * @return error code
+ */
+int bus_read_block(const bus_t bus, addr_t address, data_t* data, size_t size);
+
+
 /**
  * @brief Write to the bus at a given address
  *
@@ -95,6 +108,22 @@ int bus_read(const bus_t bus, addr_t address, data_t* data);
  */
 int bus_write(bus_t bus, addr_t address, data_t data);
 
+/**
+ * @brief Write a block to the bus: each contiguous range of a component
+ *        is copied at once. Nothing is written if an address is unmapped.
+ *        As for bus_write(), no component is notified: the LCD controler
+ *        renders from its own copy of the video memory and OAM, which
+ *        misses these bytes unless told with lcdc_invalidate_range()
+ *        (as gameboy_write_block() does).
+ *
+ * @param bus bus to write to
+ * @param address address of the first byte to write
+ * @param data bytes to write
+ * @param size number of bytes to write (the addresses wrapping around)
+ * @return error code
+ */
+int bus_write_block(bus_t bus, addr_t address, const data_t* data, size_t size);
+
 /**
  * @brief Read the bus at a given address (reads 16 bits)
  *
@@ -12,7 +12,7 @@
 #include "cpu-storage.h" // cpu_read_at_HL
 #include "cpu-registers.h" // cpu_HL_get
 
-// external library provided later to lower workload
+// the remaining instructions, see cpu-alu_ext.c
 extern int cpu_dispatch_alu_ext(const instruction_t* lu, cpu_t* cpu);
 
 #include <assert.h>
@@ -206,9 +206,8 @@ int cpu_dispatch_alu(const instruction_t* lu, cpu_t* cpu)
     } break;
 
     // ---------------------------------------------------------
-    // All the others are handled elsewhere by provided library
+    // All the others are handled in cpu-alu_ext.c
     default:
-        // uncomment this line if you have the cs212gbcpuext library
         M_EXIT_IF_ERR(cpu_dispatch_alu_ext(lu, cpu));
         break;
     } // switch
@@ -0,0 +1,256 @@
+/**
+ * @file cpu-alu_ext.c
+ * @brief Game Boy CPU simulation, ALU part formerly provided as a library
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include "error.h"
+#include "bit.h"
+#include "alu.h"
+#include "alu_ext.h"
+#include "cpu-alu.h"
+#include "cpu-storage.h" // cpu_read_at_HL
+#include "cpu-registers.h" // cpu_HL_get
+
+#include <assert.h>
+#include <inttypes.h> // PRIX8
+#include <stdio.h> // fprintf
+
+// ======================================================================
+/**
+* @brief Tool function usefull for CHG_U3_HLR:
+*        Do a SET or a RESET(=unset) of data bit,
+*          according to SR and N3 bits of instruction's opcode
+*/
+static void do_set_or_res(const instruction_t* lu, data_t* data)
+{
+    assert(lu   != NULL);
+    assert(data != NULL);
+
+    if (extract_sr_bit(lu->opcode)) {
+        bit_set(data, extract_n3(lu->opcode));
+    } else {
+        bit_unset(data, extract_n3(lu->opcode));
+    }
+}
+
+// ======================================================================
+/**
+* @brief Applies a logic operation OP (alu_and, alu_or, alu_xor) on A
+*        and ARG, with FLAGS_SRC flag sources
+*/
+#define do_cpu_logic(cpu, op, arg, flags_src) \
+    do { \
+        M_EXIT_IF_ERR(op(&cpu->alu, cpu->A, (arg))); \
+        combine_flags_set_A(cpu, flags_src); \
+    } while(0)
+
+// ======================================================================
+/**
+* @brief Applies a single-operand operation on the data at HL:
+*        CALL (on &cpu->alu) computes the result, written back at HL
+*/
+#define do_cpu_at_HL(cpu, call, flags_src) \
+    do { \
+        M_EXIT_IF_ERR(call); \
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, flags_src)); \
+        M_EXIT_IF_ERR(cpu_write_at_HL(cpu, lsb8(cpu->alu.value))); \
+    } while(0)
+
+// ======================================================================
+/**
+* @brief Applies a single-operand operation on register REG:
+*        CALL (on &cpu->alu) computes the result, written back to REG
+*/
+#define do_cpu_on_reg(cpu, reg, call, flags_src) \
+    do { \
+        M_EXIT_IF_ERR(call); \
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, flags_src)); \
+        cpu_reg_set(cpu, reg, lsb8(cpu->alu.value)); \
+    } while(0)
+
+// ==== see cpu-alu.c ========================================
+int cpu_dispatch_alu_ext(const instruction_t* lu, cpu_t* cpu)
+{
+    M_REQUIRE_NON_NULL(cpu);
+
+    switch (lu->family) {
+
+    // ADD
+    case LD_HLSP_S8: {
+        M_EXIT_IF_ERR(alu_add16_low(&cpu->alu, cpu->SP, (uint16_t)(int8_t) cpu_read_data_after_opcode(cpu)));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, CLEAR, CLEAR, ALU, ALU));
+        // bit 4 distinguishes LD HL, SP+s8 from ADD SP, s8
+        if (bit_get(lu->opcode, 4)) {
+            cpu_HL_set(cpu, cpu->alu.value);
+        } else {
+            cpu->SP = cpu->alu.value;
+        }
+    } break;
+
+
+    // SUBTRACT / COMPARE
+    case CP_A_HLR: {
+        M_EXIT_IF_ERR(alu_sub8(&cpu->alu, cpu->A, cpu_read_at_HL(cpu), 0));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SUB_FLAGS_SRC));
+    } break;
+
+    case DEC_HLR: {
+        do_cpu_at_HL(cpu, alu_sub8(&cpu->alu, cpu_read_at_HL(cpu), 1, 0), DEC_FLAGS_SRC);
+    } break;
+
+    case DEC_R16SP: {
+        reg_pair_kind reg_pair = extract_reg_pair(lu->opcode);
+        cpu->alu.value = (uint16_t)(cpu_reg_pair_SP_get(cpu, reg_pair) - 1);
+        cpu_reg_pair_SP_set(cpu, reg_pair, cpu->alu.value);
+    } break;
+
+    case SUB_A_HLR: {
+        do_cpu_arithm(cpu, alu_sub8, cpu_read_at_HL(cpu), SUB_FLAGS_SRC);
+    } break;
+
+    case SUB_A_N8: {
+        do_cpu_arithm(cpu, alu_sub8, cpu_read_data_after_opcode(cpu), SUB_FLAGS_SRC);
+    } break;
+
+    case SUB_A_R8: {
+        do_cpu_arithm(cpu, alu_sub8, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), SUB_FLAGS_SRC);
+    } break;
+
+
+    // AND, OR, XOR
+    case AND_A_HLR: {
+        do_cpu_logic(cpu, alu_and, cpu_read_at_HL(cpu), AND_FLAGS_SRC);
+    } break;
+
+    case AND_A_N8: {
+        do_cpu_logic(cpu, alu_and, cpu_read_data_after_opcode(cpu), AND_FLAGS_SRC);
+    } break;
+
+    case AND_A_R8: {
+        do_cpu_logic(cpu, alu_and, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), AND_FLAGS_SRC);
+    } break;
+
+    case OR_A_HLR: {
+        do_cpu_logic(cpu, alu_or, cpu_read_at_HL(cpu), OR_FLAGS_SRC);
+    } break;
+
+    case OR_A_N8: {
+        do_cpu_logic(cpu, alu_or, cpu_read_data_after_opcode(cpu), OR_FLAGS_SRC);
+    } break;
+
+    case OR_A_R8: {
+        do_cpu_logic(cpu, alu_or, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), OR_FLAGS_SRC);
+    } break;
+
+    case XOR_A_HLR: {
+        do_cpu_logic(cpu, alu_xor, cpu_read_at_HL(cpu), OR_FLAGS_SRC);
+    } break;
+
+    case XOR_A_N8: {
+        do_cpu_logic(cpu, alu_xor, cpu_read_data_after_opcode(cpu), OR_FLAGS_SRC);
+    } break;
+
+    case XOR_A_R8: {
+        do_cpu_logic(cpu, alu_xor, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), OR_FLAGS_SRC);
+    } break;
+
+
+    // BIT MOVE (rotate, shift)
+    case ROTA: {
+        M_EXIT_IF_ERR(alu_carry_rotate(&cpu->alu, cpu->A, extract_rot_dir(lu->opcode), cpu->F));
+        combine_flags_set_A(cpu, ROT_FLAGS_SRC);
+    } break;
+
+    case ROTCA: {
+        M_EXIT_IF_ERR(alu_rotate(&cpu->alu, cpu->A, extract_rot_dir(lu->opcode)));
+        combine_flags_set_A(cpu, ROT_FLAGS_SRC);
+    } break;
+
+    case ROTC_HLR: {
+        do_cpu_at_HL(cpu, alu_rotate(&cpu->alu, cpu_read_at_HL(cpu), extract_rot_dir(lu->opcode)), SHIFT_FLAGS_SRC);
+    } break;
+
+    case ROTC_R8: {
+        reg_kind reg = extract_reg(lu->opcode, 0);
+        do_cpu_on_reg(cpu, reg, alu_rotate(&cpu->alu, cpu_reg_get(cpu, reg), extract_rot_dir(lu->opcode)), SHIFT_FLAGS_SRC);
+    } break;
+
+    case ROT_HLR: {
+        do_cpu_at_HL(cpu, alu_carry_rotate(&cpu->alu, cpu_read_at_HL(cpu), extract_rot_dir(lu->opcode), cpu->F), SHIFT_FLAGS_SRC);
+    } break;
+
+    case SWAP_HLR: {
+        do_cpu_at_HL(cpu, alu_swap4(&cpu->alu, cpu_read_at_HL(cpu)), OR_FLAGS_SRC);
+    } break;
+
+    case SWAP_R8: {
+        reg_kind reg = extract_reg(lu->opcode, 0);
+        do_cpu_on_reg(cpu, reg, alu_swap4(&cpu->alu, cpu_reg_get(cpu, reg)), OR_FLAGS_SRC);
+    } break;
+
+    case SLA_HLR: {
+        do_cpu_at_HL(cpu, alu_shift(&cpu->alu, cpu_read_at_HL(cpu), LEFT), SHIFT_FLAGS_SRC);
+    } break;
+
+    case SRA_HLR: {
+        do_cpu_at_HL(cpu, alu_shiftR_A(&cpu->alu, cpu_read_at_HL(cpu)), SHIFT_FLAGS_SRC);
+    } break;
+
+    case SRA_R8: {
+        reg_kind reg = extract_reg(lu->opcode, 0);
+        do_cpu_on_reg(cpu, reg, alu_shiftR_A(&cpu->alu, cpu_reg_get(cpu, reg)), SHIFT_FLAGS_SRC);
+    } break;
+
+    case SRL_HLR: {
+        do_cpu_at_HL(cpu, alu_shift(&cpu->alu, cpu_read_at_HL(cpu), RIGHT), SHIFT_FLAGS_SRC);
+    } break;
+
+    case SRL_R8: {
+        reg_kind reg = extract_reg(lu->opcode, 0);
+        do_cpu_on_reg(cpu, reg, alu_shift(&cpu->alu, cpu_reg_get(cpu, reg), RIGHT), SHIFT_FLAGS_SRC);
+    } break;
+
+
+    // BIT TESTS (and set)
+    case BIT_U3_HLR: {
+        bit_t bit = bit_get(cpu_read_at_HL(cpu), extract_n3(lu->opcode));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, (0 == bit) ? SET : CLEAR, CLEAR, SET, CPU));
+    } break;
+
+    case CHG_U3_HLR: {
+        data_t data = cpu_read_at_HL(cpu);
+        do_set_or_res(lu, &data);
+        M_EXIT_IF_ERR(cpu_write_at_HL(cpu, data));
+    } break;
+
+
+    // MISC. ALU
+    case CPL: {
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, CPU, SET, SET, CPU));
+        cpu->A = (data_t) ~cpu->A;
+    } break;
+
+    case DAA: {
+        cpu->alu.value = cpu->A;
+        cpu->alu.flags = cpu->F;
+        M_EXIT_IF_ERR(alu_bcd_adjust(&cpu->alu));
+        combine_flags_set_A(cpu, DAA_FLAGS_SRC);
+    } break;
+
+    case SCCF: {
+        // SCF sets the carry, CCF complements it
+        const bit_t carry = extract_sccf(lu->opcode) && get_C(cpu->F);
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, CPU, CLEAR, CLEAR, carry ? CLEAR : SET));
+    } break;
+
+    default:
+        fprintf(stderr, "Unknown ALU instruction, Code: 0x%" PRIX8 "\n", cpu_read_at_idx(cpu, cpu->PC));
+        return ERR_INSTR;
+        break;
+    } // switch
+
+    return ERR_NONE;
+}
@@ -13,6 +13,7 @@
 #include "util.h"
 #include "gameboy.h"
 #include "bit.h"
+#include "timeline.h"
 
 #include <inttypes.h> // PRIX8
 #include <stdio.h> // fprintf
@@ -21,6 +22,15 @@
 #define interrupt_address(interruption) \
     0x40 + ((addr_t)interruption << 3)
 
+#ifdef TIMELINE
+static const char* const INTERRUPT_REQUESTED[INTERRUPT_COUNT] = {
+    "VBLANK requested", "LCD_STAT requested", "TIMER requested", "SERIAL requested", "JOYPAD requested"
+};
+static const char* const INTERRUPT_SERVED[INTERRUPT_COUNT] = {
+    "VBLANK served", "LCD_STAT served", "TIMER served", "SERIAL served", "JOYPAD served"
+};
+#endif
+
 // ======================================================================
 int cpu_init(cpu_t *cpu)
 {
@@ -326,6 +336,7 @@ static int cpu_do_cycle(cpu_t *cpu)
         cpu_SP_push(cpu, cpu->PC);
         cpu->PC = interrupt_address(interrupt);
         cpu->idle_time += INTERRUPT_CYCLES;
+        timeline_instant(INTERRUPT_SERVED[interrupt], "interrupt");
     }
     else
     {
@@ -389,5 +400,6 @@ void cpu_request_interrupt(cpu_t* cpu, interrupt_t i)
     if (NULL != cpu && i < INTERRUPT_COUNT)
     {
         cpu->IF |= (1 << i);
+        timeline_instant(INTERRUPT_REQUESTED[i], "interrupt");
     }
 }
@@ -0,0 +1,467 @@
+/**
+ * @file framebuffer.c
+ * @brief Packed framebuffer and its line operations
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "framebuffer.h"
+#include "error.h"
+#include "hash.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRAMEBUFFER_SIMD
+#include <immintrin.h>
+#endif
+
+#define round_up(size, align) (((size) + (align) - 1) / (align) * (align))
+
+// a byte of value 1 in each byte of a 64-bit word
+#define BYTES_ONE UINT64_C(0x0101010101010101)
+
+// ======================================================================
+/*
+ * Kernels of the per-pixel operations, in scalar, SSSE3 and AVX2 versions,
+ * and of the conversions between pixels and bits, in scalar and BMI2/SSE2
+ * versions. As for the bit vectors, the best versions supported by the CPU
+ * are selected once at load time.
+ */
+typedef void (*map_colors_t)(uint8_t* dst, const uint8_t* src, size_t count, const uint8_t colors[4]);
+typedef void (*select_t)(uint8_t* pixels, uint8_t* opacity, const uint8_t* pixels1, const uint8_t* opacity1,
+                         const uint8_t* pixels2, const uint8_t* mask, size_t count);
+typedef uint64_t (*unpack_t)(uint8_t msb, uint8_t lsb);
+typedef void (*pack_t)(const uint8_t* pixels, const uint8_t* opacity, uint32_t* msb, uint32_t* lsb,
+                       uint32_t* opacity_bits);
+
+static void map_colors_scalar(uint8_t* dst, const uint8_t* src, size_t count, const uint8_t colors[4])
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        dst[i] = colors[src[i] & 0x3];
+    }
+}
+
+// pixels2 where mask (0 or 1) is set, pixels1 elsewhere; opacity1 or mask
+static void select_scalar(uint8_t* pixels, uint8_t* opacity, const uint8_t* pixels1, const uint8_t* opacity1,
+                          const uint8_t* pixels2, const uint8_t* mask, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        // branchless select, mask being 0 or 1
+        const uint8_t m = (uint8_t)-mask[i];
+        pixels[i] = (uint8_t)((pixels2[i] & m) | (pixels1[i] & ~m));
+        opacity[i] = opacity1[i] | mask[i];
+    }
+}
+
+// bit i of byte to byte i: byte i of (byte times BYTES_ONE) keeps its bit i,
+// which adding 0x7F carries to bit 7 of the byte
+static uint64_t spread_bits(uint8_t byte)
+{
+    const uint64_t kept = (byte * BYTES_ONE) & UINT64_C(0x8040201008040201);
+    return ((kept + UINT64_C(0x7F7F7F7F7F7F7F7F)) >> 7) & BYTES_ONE;
+}
+
+static uint64_t unpack_scalar(uint8_t msb, uint8_t lsb)
+{
+    return spread_bits(msb) << 1 | spread_bits(lsb);
+}
+
+// bit 0 of the 8 bytes of word to a byte: the multiplication moves
+// bit 0 of byte i to bit 56 + i, without carries
+static uint32_t gather_bits(uint64_t word)
+{
+    return (uint32_t)(((word & BYTES_ONE) * UINT64_C(0x0102040810204080)) >> 56);
+}
+
+// 32 pixels
+static void pack_scalar(const uint8_t* pixels, const uint8_t* opacity, uint32_t* msb, uint32_t* lsb,
+                        uint32_t* opacity_bits)
+{
+    *msb = *lsb = *opacity_bits = 0;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        uint64_t colors = 0;
+        uint64_t opaque = 0;
+        memcpy(&colors, pixels + 8 * i, sizeof(colors));
+        memcpy(&opaque, opacity + 8 * i, sizeof(opaque));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        colors = __builtin_bswap64(colors);
+        opaque = __builtin_bswap64(opaque);
+#endif
+        *msb |= gather_bits(colors >> 1) << (8 * i);
+        *lsb |= gather_bits(colors) << (8 * i);
+        *opacity_bits |= gather_bits(opaque) << (8 * i);
+    }
+}
+
+static struct {
+    map_colors_t map_colors;
+    select_t select;
+    unpack_t unpack;
+    pack_t pack;
+} kernels = { map_colors_scalar, select_scalar, unpack_scalar, pack_scalar };
+
+#ifdef FRAMEBUFFER_SIMD
+// vectors of width pixels, then the remaining pixels in scalar
+#define DEFINE_SIMD_KERNELS(isa, isa_name, vec, width, load, store, set1, and_op, andnot_op, or_op, sub_op, \
+                            shuffle_op) \
+    __attribute__((target(isa_name))) \
+    static void map_colors_##isa(uint8_t* dst, const uint8_t* src, size_t count, const uint8_t colors[4]) \
+    { \
+        /* the colors at indices 0 to 3 of each 16-byte lane */ \
+        uint8_t lanes[sizeof(vec)]; \
+        for (size_t k = 0; k < sizeof(vec); ++k) \
+        { \
+            lanes[k] = colors[k & 0x3]; \
+        } \
+        const vec table = load((const vec*) lanes); \
+        const vec three = set1(0x3); \
+        size_t i = 0; \
+        for (; i + width <= count; i += width) \
+        { \
+            store((vec*) (dst + i), shuffle_op(table, and_op(load((const vec*) (src + i)), three))); \
+        } \
+        map_colors_scalar(dst + i, src + i, count - i, colors); \
+    } \
+    __attribute__((target(isa_name))) \
+    static void select_##isa(uint8_t* pixels, uint8_t* opacity, const uint8_t* pixels1, const uint8_t* opacity1, \
+                             const uint8_t* pixels2, const uint8_t* mask, size_t count) \
+    { \
+        const vec zero = set1(0); \
+        size_t i = 0; \
+        for (; i + width <= count; i += width) \
+        { \
+            const vec m = load((const vec*) (mask + i)); \
+            const vec ones = sub_op(zero, m); \
+            const vec above = and_op(ones, load((const vec*) (pixels2 + i))); \
+            const vec below = andnot_op(ones, load((const vec*) (pixels1 + i))); \
+            const vec opaque = or_op(load((const vec*) (opacity1 + i)), m); \
+            store((vec*) (pixels + i), or_op(above, below)); \
+            store((vec*) (opacity + i), opaque); \
+        } \
+        select_scalar(pixels + i, opacity + i, pixels1 + i, opacity1 + i, pixels2 + i, mask + i, count - i); \
+    }
+
+DEFINE_SIMD_KERNELS(ssse3, "ssse3", __m128i, 16, _mm_loadu_si128, _mm_storeu_si128, _mm_set1_epi8,
+                    _mm_and_si128, _mm_andnot_si128, _mm_or_si128, _mm_sub_epi8, _mm_shuffle_epi8)
+DEFINE_SIMD_KERNELS(avx2, "avx2", __m256i, 32, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_set1_epi8,
+                    _mm256_and_si256, _mm256_andnot_si256, _mm256_or_si256, _mm256_sub_epi8, _mm256_shuffle_epi8)
+
+__attribute__((target("bmi2")))
+static uint64_t unpack_bmi2(uint8_t msb, uint8_t lsb)
+{
+    return _pdep_u64(msb, BYTES_ONE) << 1 | _pdep_u64(lsb, BYTES_ONE);
+}
+
+// moving bit b of each byte to bit 7, that movemask collects
+__attribute__((target("sse2")))
+static void pack_sse2(const uint8_t* pixels, const uint8_t* opacity, uint32_t* msb, uint32_t* lsb,
+                      uint32_t* opacity_bits)
+{
+    const __m128i colors_low = _mm_loadu_si128((const __m128i*) pixels);
+    const __m128i colors_high = _mm_loadu_si128((const __m128i*) (pixels + 16));
+    const __m128i opaque_low = _mm_loadu_si128((const __m128i*) opacity);
+    const __m128i opaque_high = _mm_loadu_si128((const __m128i*) (opacity + 16));
+    *msb = (uint32_t) _mm_movemask_epi8(_mm_slli_epi16(colors_low, 6))
+           | (uint32_t) _mm_movemask_epi8(_mm_slli_epi16(colors_high, 6)) << 16;
+    *lsb = (uint32_t) _mm_movemask_epi8(_mm_slli_epi16(colors_low, 7))
+           | (uint32_t) _mm_movemask_epi8(_mm_slli_epi16(colors_high, 7)) << 16;
+    *opacity_bits = (uint32_t) _mm_movemask_epi8(_mm_slli_epi16(opaque_low, 7))
+                    | (uint32_t) _mm_movemask_epi8(_mm_slli_epi16(opaque_high, 7)) << 16;
+}
+
+__attribute__((constructor))
+static void select_kernels(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.map_colors = map_colors_avx2;
+        kernels.select = select_avx2;
+    }
+    else if (__builtin_cpu_supports("ssse3"))
+    {
+        kernels.map_colors = map_colors_ssse3;
+        kernels.select = select_ssse3;
+    }
+    if (__builtin_cpu_supports("bmi2"))
+    {
+        kernels.unpack = unpack_bmi2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        kernels.pack = pack_sse2;
+    }
+}
+#endif
+
+// ======================================================================
+#define M_REQUIRE_NON_NULL_PIXEL_LINE(line) \
+    do { \
+        M_REQUIRE_NON_NULL((line).pixels); \
+        M_REQUIRE_NON_NULL((line).opacity); \
+    } while(0)
+
+#define M_REQUIRE_MATCHING_PIXEL_LINE_SIZE(line1, line2) \
+    do { \
+        M_REQUIRE_NON_NULL_PIXEL_LINE(line1); \
+        M_REQUIRE_NON_NULL_PIXEL_LINE(line2); \
+        M_REQUIRE((line1).size == (line2).size, ERR_BAD_PARAMETER, "%s", "Sizes do not match"); \
+    } while(0)
+
+// ======================================================================
+int framebuffer_create(framebuffer_t* fb, size_t width, size_t height)
+{
+    M_REQUIRE_NON_NULL(fb);
+    M_REQUIRE(width > 0, ERR_BAD_PARAMETER, "%s", "Parameter width is zero.");
+    M_REQUIRE(height > 0, ERR_BAD_PARAMETER, "%s", "Parameter height is zero.");
+
+    // the planes size is a multiple of the alignment, as aligned_alloc requires
+    uint8_t* planes = aligned_alloc(FRAMEBUFFER_ALIGN, framebuffer_planes_size(width, height));
+    if (NULL == planes)
+    {
+        return ERR_MEM;
+    }
+    memset(planes, 0, framebuffer_planes_size(width, height));
+
+    framebuffer_init(fb, width, height, planes);
+    return ERR_NONE;
+}
+
+size_t framebuffer_planes_size(size_t width, size_t height)
+{
+    return 2 * round_up(width, FRAMEBUFFER_ALIGN) * height;
+}
+
+void framebuffer_init(framebuffer_t* fb, size_t width, size_t height, uint8_t* planes)
+{
+    const size_t stride = round_up(width, FRAMEBUFFER_ALIGN);
+    fb->width = width;
+    fb->height = height;
+    fb->stride = stride;
+    fb->pixels = planes;
+    fb->opacity = planes + stride * height;
+}
+
+pixel_line_t framebuffer_line(const framebuffer_t* fb, size_t y)
+{
+    return (pixel_line_t) {
+        .pixels = fb->pixels + y * fb->stride,
+        .opacity = fb->opacity + y * fb->stride,
+        .size = fb->width
+    };
+}
+
+uint64_t framebuffer_hash(const framebuffer_t* fb)
+{
+    // the lines are chained, without the padding of the stride
+    uint64_t hash = 0;
+    for (size_t y = 0; y < fb->height; ++y)
+    {
+        hash = hash64(fb->pixels + y * fb->stride, fb->width, hash);
+    }
+    return hash;
+}
+
+int framebuffer_to_rgb(const framebuffer_t* fb, const framebuffer_shades_t* shades,
+                       size_t bytes_per_pixel, uint8_t* output, size_t output_stride)
+{
+    M_REQUIRE_NON_NULL(fb);
+    M_REQUIRE_NON_NULL(fb->pixels);
+    M_REQUIRE_NON_NULL(shades);
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE(bytes_per_pixel == FRAMEBUFFER_RGB || bytes_per_pixel == FRAMEBUFFER_RGBA,
+              ERR_BAD_PARAMETER, "%zu bytes per pixel is neither RGB nor RGBA", bytes_per_pixel);
+    M_REQUIRE(output_stride >= fb->width * bytes_per_pixel, ERR_BAD_PARAMETER,
+              "stride of %zu bytes too short", output_stride);
+
+    // a pixel is a single 4 bytes store of its shade
+    uint32_t lut[4];
+    memcpy(lut, shades->rgba, sizeof(lut));
+
+    for (size_t y = 0; y < fb->height; ++y)
+    {
+        const uint8_t* const pixels = fb->pixels + y * fb->stride;
+        uint8_t* const row = output + y * output_stride;
+        if (bytes_per_pixel == FRAMEBUFFER_RGBA)
+        {
+            for (size_t x = 0; x < fb->width; ++x)
+            {
+                memcpy(row + FRAMEBUFFER_RGBA * x, &lut[pixels[x] & 3], FRAMEBUFFER_RGBA);
+            }
+        }
+        else
+        {
+            // the 4th byte is overwritten by the next pixel, except for the last one
+            const size_t last = fb->width - 1;
+            for (size_t x = 0; x < last; ++x)
+            {
+                memcpy(row + FRAMEBUFFER_RGB * x, &lut[pixels[x] & 3], FRAMEBUFFER_RGBA);
+            }
+            memcpy(row + FRAMEBUFFER_RGB * last, &lut[pixels[last] & 3], FRAMEBUFFER_RGB);
+        }
+    }
+    return ERR_NONE;
+}
+
+void framebuffer_free(framebuffer_t* fb)
+{
+    if (NULL != fb)
+    {
+        // opacity belongs to the same allocation
+        free(fb->pixels);
+        *fb = (framebuffer_t) { 0 };
+    }
+}
+
+// ======================================================================
+int pixel_line_shift(pixel_line_t output, pixel_line_t iml, int64_t shift)
+{
+    M_REQUIRE_MATCHING_PIXEL_LINE_SIZE(output, iml);
+    M_REQUIRE(output.pixels != iml.pixels, ERR_BAD_PARAMETER, "%s", "Cannot shift in place");
+
+    const int64_t size = (int64_t)iml.size;
+    if (shift >= size || shift <= -size)
+    {
+        memset(output.pixels, 0, iml.size);
+        memset(output.opacity, 0, iml.size);
+    }
+    else if (shift >= 0)
+    {
+        memset(output.pixels, 0, (size_t)shift);
+        memset(output.opacity, 0, (size_t)shift);
+        memcpy(output.pixels + shift, iml.pixels, (size_t)(size - shift));
+        memcpy(output.opacity + shift, iml.opacity, (size_t)(size - shift));
+    }
+    else
+    {
+        memcpy(output.pixels, iml.pixels - shift, (size_t)(size + shift));
+        memcpy(output.opacity, iml.opacity - shift, (size_t)(size + shift));
+        memset(output.pixels + size + shift, 0, (size_t)-shift);
+        memset(output.opacity + size + shift, 0, (size_t)-shift);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+int pixel_line_extract_wrap(pixel_line_t output, pixel_line_t iml, int64_t index)
+{
+    M_REQUIRE_NON_NULL_PIXEL_LINE(output);
+    M_REQUIRE_NON_NULL_PIXEL_LINE(iml);
+    M_REQUIRE(iml.size > 0, ERR_BAD_PARAMETER, "%s", "Cannot extract from an empty line");
+    M_REQUIRE(output.pixels != iml.pixels, ERR_BAD_PARAMETER, "%s", "Cannot extract in place");
+
+    // copies the longest contiguous runs of the source
+    const int64_t size = (int64_t)iml.size;
+    size_t from = (size_t)(((index % size) + size) % size);
+    size_t done = 0;
+    while (done < output.size)
+    {
+        size_t run = iml.size - from;
+        if (run > output.size - done)
+        {
+            run = output.size - done;
+        }
+        memcpy(output.pixels + done, iml.pixels + from, run);
+        memcpy(output.opacity + done, iml.opacity + from, run);
+        done += run;
+        from = 0;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+int pixel_line_map_colors(pixel_line_t output, pixel_line_t iml, uint8_t map)
+{
+    M_REQUIRE_MATCHING_PIXEL_LINE_SIZE(output, iml);
+
+    const uint8_t colors[4] = {
+        map & 0x3, (map >> 2) & 0x3, (map >> 4) & 0x3, (map >> 6) & 0x3
+    };
+    kernels.map_colors(output.pixels, iml.pixels, iml.size, colors);
+    if (output.opacity != iml.opacity)
+    {
+        memcpy(output.opacity, iml.opacity, iml.size);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+int pixel_line_below_with_opacity(pixel_line_t output, pixel_line_t iml1, pixel_line_t iml2,
+                                  const uint8_t* opacity)
+{
+    M_REQUIRE_MATCHING_PIXEL_LINE_SIZE(output, iml1);
+    M_REQUIRE_MATCHING_PIXEL_LINE_SIZE(iml1, iml2);
+    M_REQUIRE_NON_NULL(opacity);
+
+    kernels.select(output.pixels, output.opacity, iml1.pixels, iml1.opacity, iml2.pixels, opacity, iml1.size);
+    return ERR_NONE;
+}
+
+int pixel_line_below(pixel_line_t output, pixel_line_t iml1, pixel_line_t iml2)
+{
+    M_REQUIRE_NON_NULL_PIXEL_LINE(iml2);
+    return pixel_line_below_with_opacity(output, iml1, iml2, iml2.opacity);
+}
+
+// ======================================================================
+int pixel_line_join(pixel_line_t output, pixel_line_t iml1, pixel_line_t iml2, int64_t start)
+{
+    M_REQUIRE_MATCHING_PIXEL_LINE_SIZE(output, iml1);
+    M_REQUIRE_MATCHING_PIXEL_LINE_SIZE(iml1, iml2);
+    M_REQUIRE(start >= 0, ERR_BAD_PARAMETER, "Incorrect start (%ld < 0)", start);
+    M_REQUIRE(start < (int64_t)iml1.size, ERR_BAD_PARAMETER,
+              "Incorrect start (%ld >= %zu)", start, iml1.size);
+
+    if (output.pixels != iml1.pixels)
+    {
+        memcpy(output.pixels, iml1.pixels, (size_t)start);
+        memcpy(output.opacity, iml1.opacity, (size_t)start);
+    }
+    if (output.pixels != iml2.pixels)
+    {
+        memcpy(output.pixels + start, iml2.pixels + start, iml1.size - (size_t)start);
+        memcpy(output.opacity + start, iml2.opacity + start, iml1.size - (size_t)start);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+void pixel_row_unpack(uint8_t pixels[8], uint8_t msb, uint8_t lsb)
+{
+    uint64_t colors = kernels.unpack(msb, lsb);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    colors = __builtin_bswap64(colors);
+#endif
+    memcpy(pixels, &colors, sizeof(colors));
+}
+
+// ======================================================================
+int pixel_line_pack(pixel_line_t line, uint32_t* msb, uint32_t* lsb, uint32_t* opacity)
+{
+    M_REQUIRE_NON_NULL_PIXEL_LINE(line);
+    M_REQUIRE_NON_NULL(msb);
+    M_REQUIRE_NON_NULL(lsb);
+    M_REQUIRE_NON_NULL(opacity);
+
+    size_t x = 0;
+    for (; x + 32 <= line.size; x += 32)
+    {
+        kernels.pack(line.pixels + x, line.opacity + x, msb++, lsb++, opacity++);
+    }
+    if (x < line.size)
+    {
+        // the last pixels, padded with transparent pixels of color 0
+        uint8_t pixels[32] = { 0 };
+        uint8_t opaque[32] = { 0 };
+        memcpy(pixels, line.pixels + x, line.size - x);
+        memcpy(opaque, line.opacity + x, line.size - x);
+        kernels.pack(pixels, opaque, msb, lsb, opacity);
+    }
+    return ERR_NONE;
+}
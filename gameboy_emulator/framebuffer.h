@@ -0,0 +1,206 @@
+#pragma once
+
+/**
+ * @file framebuffer.h
+ * @brief Packed framebuffer: one byte per pixel for its color (0-3) and one byte
+ *        per pixel for its opacity (0 or 1), in two flat aligned planes;
+ *        and the line operations of image.h on this representation,
+ *        writing into lines provided by the caller (no allocation)
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Alignment of the planes and of each of their lines (in bytes)
+#define FRAMEBUFFER_ALIGN 64
+
+/**
+ * @brief Type to represent a framebuffer
+ */
+typedef struct {
+    size_t width;
+    size_t height;
+    size_t stride;    // bytes between two lines (width rounded up to FRAMEBUFFER_ALIGN)
+    uint8_t* pixels;  // height lines of stride bytes
+    uint8_t* opacity; // same layout as pixels
+} framebuffer_t;
+
+/**
+ * @brief Type to represent a line of pixels (in a framebuffer or not)
+ */
+typedef struct {
+    uint8_t* pixels;
+    uint8_t* opacity;
+    size_t size;
+} pixel_line_t;
+
+// Color of a pixel, without any check
+#define framebuffer_pixel(fb, x, y) ((fb)->pixels[(y) * (fb)->stride + (x)])
+
+
+/**
+ * @brief Creates a framebuffer, all pixels of color 0 and transparent
+ *        (both planes in a single aligned allocation)
+ *
+ * @param fb framebuffer to create
+ * @param width width in pixels
+ * @param height height in pixels
+ * @return error code
+ */
+int framebuffer_create(framebuffer_t* fb, size_t width, size_t height);
+
+
+/**
+ * @brief Size of the planes of a framebuffer (a multiple of FRAMEBUFFER_ALIGN)
+ *
+ * @param width width in pixels
+ * @param height height in pixels
+ * @return size in bytes
+ */
+size_t framebuffer_planes_size(size_t width, size_t height);
+
+
+/**
+ * @brief Initializes a framebuffer on planes allocated by the caller
+ *        (not to be freed with framebuffer_free())
+ *
+ * @param fb framebuffer to initialize
+ * @param width width in pixels
+ * @param height height in pixels
+ * @param planes FRAMEBUFFER_ALIGN aligned memory of framebuffer_planes_size() bytes
+ */
+void framebuffer_init(framebuffer_t* fb, size_t width, size_t height, uint8_t* planes);
+
+
+/**
+ * @brief Gives access to a line of a framebuffer
+ *
+ * @param fb framebuffer
+ * @param y line index (must be lower than the height)
+ * @return the line, pointing into the framebuffer
+ */
+pixel_line_t framebuffer_line(const framebuffer_t* fb, size_t y);
+
+
+/**
+ * @brief Hashes the colors of the pixels of a framebuffer (see hash.h)
+ *
+ * @param fb framebuffer
+ * @return the hash
+ */
+uint64_t framebuffer_hash(const framebuffer_t* fb);
+
+
+// Bytes per pixel of the packed outputs of framebuffer_to_rgb()
+#define FRAMEBUFFER_RGB  3
+#define FRAMEBUFFER_RGBA 4
+
+/**
+ * @brief Shades of the 4 colors, as R, G, B and A bytes (A unused in RGB)
+ */
+typedef struct {
+    uint8_t rgba[4][FRAMEBUFFER_RGBA];
+} framebuffer_shades_t;
+
+// Grey shades of the Game Boy: 255 - 85 * color, opaque
+#define FRAMEBUFFER_GREY_SHADES { { \
+    { 255, 255, 255, 255 }, { 170, 170, 170, 255 }, \
+    {  85,  85,  85, 255 }, {   0,   0,   0, 255 } } }
+
+
+/**
+ * @brief Converts a framebuffer to packed RGB or RGBA pixels, at its resolution,
+ *        in a single pass: a pixel of color c gets the bytes of shades->rgba[c]
+ *
+ * @param fb framebuffer to convert
+ * @param shades shades of the colors
+ * @param bytes_per_pixel FRAMEBUFFER_RGB or FRAMEBUFFER_RGBA
+ * @param output written pixels, fb->height rows of output_stride bytes
+ * @param output_stride bytes between two rows (at least fb->width * bytes_per_pixel)
+ * @return error code
+ */
+int framebuffer_to_rgb(const framebuffer_t* fb, const framebuffer_shades_t* shades,
+                       size_t bytes_per_pixel, uint8_t* output, size_t output_stride);
+
+
+/**
+ * @brief Frees a framebuffer
+ *
+ * @param fb framebuffer to free
+ */
+void framebuffer_free(framebuffer_t* fb);
+
+
+/*
+ * Line operations, with the semantics of their image_line_* counterparts.
+ * The output must be of the size of the input(s); it may be one of the inputs,
+ * except for pixel_line_shift and pixel_line_extract_wrap.
+ */
+
+/**
+ * @brief Shifts a line: output[i] = iml[i - shift] (transparent color 0 outside)
+ */
+int pixel_line_shift(pixel_line_t output, pixel_line_t iml, int64_t shift);
+
+/**
+ * @brief Extracts a line, wrapping around: output[i] = iml[(index + i) mod size]
+ *        (the output can be of any size)
+ */
+int pixel_line_extract_wrap(pixel_line_t output, pixel_line_t iml, int64_t index);
+
+/**
+ * @brief Applies a palette: color c becomes bits 2c+1 and 2c of map, opacity is kept
+ */
+int pixel_line_map_colors(pixel_line_t output, pixel_line_t iml, uint8_t map);
+
+/**
+ * @brief Puts iml2 over iml1 where opacity is set; output opacity is iml1's or opacity
+ */
+int pixel_line_below_with_opacity(pixel_line_t output, pixel_line_t iml1, pixel_line_t iml2,
+                                  const uint8_t* opacity);
+
+/**
+ * @brief Puts iml2 over iml1, using iml2 opacity
+ */
+int pixel_line_below(pixel_line_t output, pixel_line_t iml1, pixel_line_t iml2);
+
+/**
+ * @brief Joins two lines: iml1 before start, iml2 from start
+ */
+int pixel_line_join(pixel_line_t output, pixel_line_t iml1, pixel_line_t iml2, int64_t start);
+
+
+/*
+ * Conversions from and to the bits of image lines (pixel i in bit i).
+ */
+
+/**
+ * @brief Unpacks 8 pixels given by the bits of their colors
+ *
+ * @param pixels written colors of the pixels
+ * @param msb msb of the colors
+ * @param lsb lsb of the colors
+ */
+void pixel_row_unpack(uint8_t pixels[8], uint8_t msb, uint8_t lsb);
+
+/**
+ * @brief Packs a line into words of 32 pixels (the bits past its size being 0)
+ *
+ * @param line line to pack
+ * @param msb written msb of the colors, (size + 31) / 32 words
+ * @param lsb written lsb of the colors, idem
+ * @param opacity written opacity, idem
+ * @return error code
+ */
+int pixel_line_pack(pixel_line_t line, uint32_t* msb, uint32_t* lsb, uint32_t* opacity);
+
+#ifdef __cplusplus
+}
+#endif
@@ -9,8 +9,12 @@
 #include "gameboy.h"
 #include "error.h"
 #include "bootrom.h"
+#include "heatmap.h"
 #include "assert.h"
 
+#include <stdio.h>
+#include <string.h>
+
 static int component_connect(gameboy_t *gameboy, component_type type, size_t size, addr_t start, addr_t end)
 {
     M_REQUIRE_NO_ERR(component_create(&gameboy->components[type], size));
@@ -18,6 +22,27 @@ static int component_connect(gameboy_t *gameboy, component_type type, size_t siz
     return ERR_NONE;
 }
 
+#ifdef PROFILER
+/**
+ * @brief Starts profiling, with the symbols of the RGBDS .sym file next to the ROM if any
+ */
+static int gameboy_profiler_init(gameboy_t *gameboy, const char *filename)
+{
+    M_REQUIRE_NO_ERR(profiler_init(&gameboy->profiler, PROFILER_OUTPUT, PROFILER_PERIOD));
+
+    char sym_filename[FILENAME_MAX];
+    const char *dot = strrchr(filename, '.');
+    const int length = (NULL == dot || NULL != strchr(dot, '/')) ? (int)strlen(filename) : (int)(dot - filename);
+    if (snprintf(sym_filename, FILENAME_MAX, "%.*s.sym", length, filename) < FILENAME_MAX)
+    {
+        // the .sym file is optional: without it, frames are plain ROM addresses
+        const int err = profiler_load_symbols(&gameboy->profiler, sym_filename);
+        M_REQUIRE(ERR_NONE == err || ERR_IO == err, err, "%s", "cannot load symbols");
+    }
+    return ERR_NONE;
+}
+#endif
+
 int gameboy_create(gameboy_t *gameboy, const char *filename)
 {
     M_REQUIRE_NON_NULL(gameboy);
@@ -62,6 +87,24 @@ int gameboy_create(gameboy_t *gameboy, const char *filename)
 
     M_REQUIRE_NO_ERR(joypad_init_and_plug(&gameboy->pad, &gameboy->cpu));
 
+#ifdef PROFILER
+    M_REQUIRE_NO_ERR(gameboy_profiler_init(gameboy, filename));
+#endif
+#ifdef TIMING
+    M_REQUIRE_NO_ERR(timing_init(&gameboy->timing, TIMING_OUTPUT));
+#endif
+#ifdef TRACE
+    M_REQUIRE_NO_ERR(trace_init(&gameboy->trace));
+#endif
+#ifdef TIMELINE
+    // no LCD mode yet: the first one is marked on the first cycle
+    gameboy->lcd_mode = 0xFF;
+    M_REQUIRE_NO_ERR(timeline_open(TIMELINE_OUTPUT));
+#endif
+#ifdef HEATMAP
+    heatmap_reset();
+#endif
+
     return ERR_NONE;
 }
 
@@ -84,6 +127,22 @@ void gameboy_free(gameboy_t *gameboy)
     assert(!bus_unplug(gameboy->bus, &gameboy->cpu.high_ram));
     lcdc_free(&gameboy->screen);
     cpu_free(&gameboy->cpu);
+    bit_vector_pool_reset();
+#ifdef PROFILER
+    profiler_free(&gameboy->profiler);
+#endif
+#ifdef TIMING
+    timing_free(&gameboy->timing);
+#endif
+#ifdef TRACE
+    trace_free(&gameboy->trace);
+#endif
+#ifdef TIMELINE
+    timeline_close();
+#endif
+#ifdef HEATMAP
+    heatmap_dump(HEATMAP_OUTPUT);
+#endif
 }
 
 #ifdef BLARGG
@@ -100,19 +159,61 @@ static int blargg_bus_listener(gameboy_t *gameboy, addr_t addr)
 }
 #endif
 
-int gameboy_run_until(gameboy_t *gameboy, uint64_t cycle)
+#ifdef TIMELINE
+static const char* const LCD_MODE_NAMES[] = {
+    "LCD mode 0 (HBLANK)", "LCD mode 1 (VBLANK)", "LCD mode 2 (OAM)", "LCD mode 3 (drawing)"
+};
+
+/**
+ * @brief Marks the changes of the LCD mode (bits 0-1 of STAT) on the timeline
+ */
+static int gameboy_timeline_lcd_mode(gameboy_t *gameboy)
 {
-    M_REQUIRE_NON_NULL(gameboy);
-    if (cycle < gameboy->cycles)
+    data_t stat = 0;
+    M_REQUIRE_NO_ERR(bus_read(gameboy->bus, REG_STAT, &stat));
+    const data_t mode = stat & 0x03;
+    if (mode != gameboy->lcd_mode)
     {
-        return ERR_BAD_PARAMETER;
+        timeline_instant(LCD_MODE_NAMES[mode], "lcdc");
+        gameboy->lcd_mode = mode;
     }
+    return ERR_NONE;
+}
+#endif
 
+/**
+ * @brief Runs the gameboy until a given cycle (see gameboy_run_until)
+ */
+static int gameboy_run(gameboy_t *gameboy, uint64_t cycle)
+{
     while (gameboy->cycles < cycle)
     {
+        timing_start(&gameboy->timing);
         M_REQUIRE_NO_ERR(timer_cycle(&gameboy->timer));
+        timing_lap(&gameboy->timing, TIMING_TIMER);
         M_REQUIRE_NO_ERR(lcdc_cycle(&gameboy->screen, gameboy->cycles));
+        #ifdef TIMELINE
+        M_REQUIRE_NO_ERR(gameboy_timeline_lcd_mode(gameboy));
+        #endif
+        timing_lap(&gameboy->timing, TIMING_LCDC);
+        heatmap_start(*gameboy->bus[REG_STAT]);
+        #ifdef TRACE
+        M_REQUIRE_NO_ERR(trace_cycle(&gameboy->trace, &gameboy->cpu, gameboy->cycles));
+        const int err = cpu_cycle(&gameboy->cpu);
+        if (ERR_INSTR == err)
+        {
+            // keep what led to the unknown instruction
+            trace_dump(&gameboy->trace, TRACE_OUTPUT);
+        }
+        M_REQUIRE_NO_ERR(err);
+        #else
         M_REQUIRE_NO_ERR(cpu_cycle(&gameboy->cpu));
+        #endif
+        heatmap_stop();
+        timing_lap(&gameboy->timing, TIMING_CPU);
+        #ifdef PROFILER
+        M_REQUIRE_NO_ERR(profiler_cycle(&gameboy->profiler, &gameboy->cpu, gameboy->cycles));
+        #endif
 
         M_REQUIRE_NO_ERR(timer_bus_listener(&gameboy->timer, gameboy->cpu.write_listener));
         M_REQUIRE_NO_ERR(bootrom_bus_listener(gameboy, gameboy->cpu.write_listener));
@@ -121,9 +222,49 @@ int gameboy_run_until(gameboy_t *gameboy, uint64_t cycle)
         #ifdef BLARGG
         M_EXIT_IF_ERR(blargg_bus_listener(gameboy, gameboy->cpu.write_listener));
         #endif
+        timing_lap(&gameboy->timing, TIMING_LISTENERS);
 
         gameboy->cycles++;
+        #if defined(TIMING) || defined(TIMELINE) || defined(BIT_VECTOR_POOL_RESET)
+        if (0 == gameboy->cycles % FRAME_TOTAL_CYCLES)
+        {
+            #ifdef TIMING
+            timing_end_frame(&gameboy->timing);
+            #endif
+            timeline_frame(gameboy->cycles / FRAME_TOTAL_CYCLES - 1);
+            #ifdef BIT_VECTOR_POOL_RESET
+            bit_vector_pool_reset();
+            #endif
+        }
+        #endif
     }
 
     return ERR_NONE;
 }
+
+int gameboy_run_until(gameboy_t *gameboy, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+    if (cycle < gameboy->cycles)
+    {
+        return ERR_BAD_PARAMETER;
+    }
+
+    timeline_begin("gameboy_run_until", "core");
+    int err = gameboy_run(gameboy, cycle);
+    if (ERR_NONE == err)
+    {
+        // the lines submitted are on the display when it is read
+        err = lcdc_sync(&gameboy->screen);
+    }
+    timeline_end("gameboy_run_until", "core");
+    return err;
+}
+
+int gameboy_write_block(gameboy_t *gameboy, addr_t address, const data_t* data, size_t size)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+
+    M_REQUIRE_NO_ERR(bus_write_block(gameboy->bus, address, data, size));
+    return lcdc_invalidate_range(&gameboy->screen, address, size);
+}
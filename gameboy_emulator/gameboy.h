@@ -18,6 +18,10 @@
 #include "cartridge.h"
 #include "joypad.h"
 #include "lcdc.h"
+#include "profiler.h"
+#include "timing.h"
+#include "trace.h"
+#include "timeline.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,6 +47,18 @@ typedef struct gameboy_
     lcdc_t screen;
     joypad_t pad;
     component_t echo;
+#ifdef PROFILER
+    profiler_t profiler;
+#endif
+#ifdef TIMING
+    timing_t timing;
+#endif
+#ifdef TRACE
+    trace_t trace;
+#endif
+#ifdef TIMELINE
+    data_t lcd_mode;
+#endif
 } gameboy_t;
 
 /**
@@ -72,6 +88,19 @@ void gameboy_free(gameboy_t* gameboy);
  */
 int gameboy_run_until(gameboy_t* gameboy, uint64_t cycle);
 
+/**
+ * @brief Writes a block to the bus (see bus_write_block()), the LCD
+ *        controler being told of the video memory and OAM bytes written
+ *        (e.g. to restore a state or a snapshot)
+ *
+ * @param gameboy pointer to the gameboy to write to
+ * @param address address of the first byte to write
+ * @param data bytes to write
+ * @param size number of bytes to write
+ * @return error code
+ */
+int gameboy_write_block(gameboy_t* gameboy, addr_t address, const data_t* data, size_t size);
+
 /**
  * @brief Adresses of the GameBoy
  *
@@ -1,9 +1,12 @@
 #include "sidlib.h"
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h> // strcmp
 #include <sys/time.h>
 #include "gameboy.h"
 #include "lcdc.h"
+#include "scale.h"
 #include "util.h"
 #include "error.h"
 
@@ -23,6 +26,12 @@
 gameboy_t gameboy;
 struct timeval start;
 struct timeval paused;
+// hash of the frame displayed, if any
+uint64_t presented_hash;
+bool presented;
+// pixel-art filter of the display (see scale.h) and the resulting scale
+scale_filter_t filter = SCALE_NONE;
+size_t scale_factor = SCALE_FACTOR;
 
 static uint64_t get_time_in_GB_cycles_since(struct timeval *from)
 {
@@ -38,28 +47,52 @@ static uint64_t get_time_in_GB_cycles_since(struct timeval *from)
 }
 
 // ======================================================================
-static void set_grey(guchar* pixels, int row, int col, int width, guchar grey)
-{
-    const size_t i = (size_t) (3 * (row * width + col)); // 3 = RGB
-    pixels[i+2] = pixels[i+1] = pixels[i] = grey;
-}
-
-// ======================================================================
-static void generate_image(guchar* pixels, int height, int width)
+static gboolean generate_image(guchar* pixels, int height, int width)
 {
     uint64_t cycles = get_time_in_GB_cycles_since(&start);
 
+    // only the frames shown at the end of the run are rendered
+    lcdc_request_display(&gameboy.screen, cycles);
     gameboy_run_until(&gameboy, cycles);
 
-    for (int y = 0; y < height; y++)
+    // static screens (menus, pauses) are not converted again
+    if (presented && gameboy.screen.frame_hash == presented_hash)
     {
-        for (int x = 0; x < width; x++)
-        {
-            uint8_t pixel_gameboy;
-            image_get_pixel(&pixel_gameboy, &gameboy.screen.display, x / SCALE_FACTOR, y / SCALE_FACTOR);
-            set_grey(pixels, y, x, width, 255 - 85 * pixel_gameboy);
-        }
+        return FALSE;
     }
+    presented_hash = gameboy.screen.frame_hash;
+    presented = true;
+
+    timeline_begin("image conversion", "frontend");
+    timing_start(&gameboy.timing);
+    // the colors of the frame filtered, if asked, then in RGB, then scaled up
+    static const framebuffer_shades_t shades = FRAMEBUFFER_GREY_SHADES;
+    static uint8_t colors[LCD_HEIGHT * SCALE_SCALE3X][LCD_WIDTH * SCALE_SCALE3X];
+    static guchar frame[LCD_HEIGHT * SCALE_SCALE3X][LCD_WIDTH * SCALE_SCALE3X * FRAMEBUFFER_RGB];
+    const framebuffer_t* source = image_framebuffer(&gameboy.screen.display);
+    const framebuffer_t filtered = {
+        .width = LCD_WIDTH * (size_t) filter,
+        .height = LCD_HEIGHT * (size_t) filter,
+        .stride = sizeof(colors[0]),
+        .pixels = &colors[0][0],
+        .opacity = NULL
+    };
+    if (filter != SCALE_NONE)
+    {
+        const pixmap_t native = { source->pixels, source->width, source->height, source->stride, 1 };
+        const pixmap_t filtered_colors = { filtered.pixels, filtered.width, filtered.height, filtered.stride, 1 };
+        // a native frame is too small to be worth other threads
+        scale_filter(&filtered_colors, &native, filter, 1);
+        source = &filtered;
+    }
+    framebuffer_to_rgb(source, &shades, FRAMEBUFFER_RGB, &frame[0][0], sizeof(frame[0]));
+    const pixmap_t rgb = { &frame[0][0], source->width, source->height, sizeof(frame[0]), FRAMEBUFFER_RGB };
+    const pixmap_t scaled = { pixels, (size_t) width, (size_t) height, FRAMEBUFFER_RGB * (size_t) width,
+                              FRAMEBUFFER_RGB };
+    scale_nearest(&scaled, &rgb, scale_factor / (size_t) filter);
+    timing_lap(&gameboy.timing, TIMING_IMAGE);
+    timeline_end("image conversion", "frontend");
+    return TRUE;
     
     
     /*static int N = 0;
@@ -135,6 +168,16 @@ static gboolean keypress_handler(guint keyval, gpointer data)
         joypad_key_pressed(&gameboy.pad, START_KEY);
         return TRUE;
 
+#ifdef TRACE
+    case 'T':
+    case 't':
+        if (ERR_NONE == trace_dump(&gameboy.trace, TRACE_OUTPUT))
+        {
+            puts("trace dumped to " TRACE_OUTPUT);
+        }
+        return TRUE;
+#endif
+
     case GDK_KEY_space:
         if (psd->timeout_id > 0)
         {
@@ -213,11 +256,29 @@ int main(int argc, char *argv[])
 {
     if (argc < 2)
     {
-        puts("please provide input_file");
+        puts("please provide input_file [scale2x|scale3x]");
         return 1;
     }
 
     const char* const filename = argv[1];
+    if (argc > 2)
+    {
+        if (!strcmp(argv[2], "scale2x"))
+        {
+            filter = SCALE_SCALE2X;
+        }
+        else if (!strcmp(argv[2], "scale3x"))
+        {
+            filter = SCALE_SCALE3X;
+        }
+        else
+        {
+            printf("unknown filter \"%s\"\n", argv[2]);
+            return 1;
+        }
+        // the multiple of the filter scale the closest to SCALE_FACTOR
+        scale_factor = (size_t) filter * ((SCALE_FACTOR + ((size_t) filter - 1) / 2) / (size_t) filter);
+    }
 
     zero_init_var(gameboy);
     int err = gameboy_create(&gameboy, filename);
@@ -227,11 +288,12 @@ int main(int argc, char *argv[])
         return err;
     }
 
+    lcdc_set_render_policy(&gameboy.screen, LCDC_RENDER_ON_DEMAND, 0);
     gettimeofday(&start, NULL);
     timerclear(&paused);
 
     sd_launch(&argc, &argv,
-              sd_init("provided key handler", LCD_WIDTH * SCALE_FACTOR, LCD_HEIGHT * SCALE_FACTOR, REFRESH_TIME,
+              sd_init("provided key handler", (int) (LCD_WIDTH * scale_factor), (int) (LCD_HEIGHT * scale_factor), REFRESH_TIME,
                       generate_image, keypress_handler, keyrelease_handler));
 
     
@@ -0,0 +1,114 @@
+/**
+ * @file hash.c
+ * @brief Fast non-cryptographic 64-bit hash (the XXH64 algorithm)
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include "hash.h"
+
+#include <string.h> // memcpy
+
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+
+// the input is consumed by stripes of 4 lanes of 8 bytes
+#define STRIPE_SIZE 32
+
+#define rotl64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+// ======================================================================
+/**
+ * @brief Reads 8 (resp. 4) bytes, little-endian
+ */
+static uint64_t read64(const uint8_t* p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t value = 0;
+    memcpy(&value, p, sizeof(value));
+    return value;
+#else
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = value << 8 | p[i];
+    }
+    return value;
+#endif
+}
+
+static uint64_t read32(const uint8_t* p)
+{
+    return (uint64_t) p[0] | (uint64_t) p[1] << 8 | (uint64_t) p[2] << 16 | (uint64_t) p[3] << 24;
+}
+
+// ======================================================================
+/**
+ * @brief Mixes a lane of input into an accumulator
+ */
+static uint64_t round64(uint64_t acc, uint64_t lane)
+{
+    acc += lane * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+// ======================================================================
+/**
+ * @brief Merges an accumulator into the hash
+ */
+static uint64_t merge_round(uint64_t hash, uint64_t acc)
+{
+    hash ^= round64(0, acc);
+    return hash * PRIME64_1 + PRIME64_4;
+}
+
+// ==== see hash.h ========================================
+uint64_t hash64(const void* data, size_t size, uint64_t seed)
+{
+    const uint8_t* p = data;
+    const uint8_t* const end = p + size;
+    uint64_t hash = 0;
+
+    if (size >= STRIPE_SIZE) {
+        uint64_t acc[4] = { seed + PRIME64_1 + PRIME64_2, seed + PRIME64_2, seed, seed - PRIME64_1 };
+        for (; end - p >= STRIPE_SIZE; p += STRIPE_SIZE) {
+            for (int i = 0; i < 4; ++i) {
+                acc[i] = round64(acc[i], read64(p + 8 * i));
+            }
+        }
+        hash = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            hash = merge_round(hash, acc[i]);
+        }
+    } else {
+        hash = seed + PRIME64_5;
+    }
+    hash += (uint64_t) size;
+
+    // the remaining bytes, 8, 4 then 1 at a time
+    for (; end - p >= 8; p += 8) {
+        hash ^= round64(0, read64(p));
+        hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (end - p >= 4) {
+        hash ^= read32(p) * PRIME64_1;
+        hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * PRIME64_5;
+        hash = rotl64(hash, 11) * PRIME64_1;
+    }
+
+    // avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/**
+ * @file hash.h
+ * @brief Fast non-cryptographic 64-bit hash (the XXH64 algorithm),
+ *        to tell frames apart
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Hashes a block of bytes (same values as XXH64)
+ *
+ * @param data bytes to hash
+ * @param size number of bytes
+ * @param seed seed of the hash, e.g. the hash of the previous block
+ *             to hash several blocks as one
+ * @return the hash
+ */
+uint64_t hash64(const void* data, size_t size, uint64_t seed);
+
+#ifdef __cplusplus
+}
+#endif
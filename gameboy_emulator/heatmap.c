@@ -0,0 +1,147 @@
+/**
+ * @file heatmap.c
+ * @brief Counters of the bus accesses of the emulated program
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "heatmap.h"
+#include "error.h"
+
+#ifdef HEATMAP
+
+_Thread_local heatmap_t heatmap;
+
+/**
+ * @brief Regions of the address space, for the summary
+ *        (page-aligned below 0xFF00, as they are counted per page there)
+ */
+typedef struct {
+    const char* name;
+    addr_t start;
+    addr_t end;
+} heatmap_region_t;
+
+static const heatmap_region_t REGIONS[] = {
+    { "ROM bank 0", 0x0000, 0x3FFF },
+    { "ROM bank N", 0x4000, 0x7FFF },
+    { "VRAM", 0x8000, 0x9FFF },
+    { "external RAM", 0xA000, 0xBFFF },
+    { "WRAM", 0xC000, 0xDFFF },
+    { "echo RAM", 0xE000, 0xFDFF },
+    { "OAM, unusable", 0xFE00, 0xFEFF },
+    { "I/O registers", 0xFF00, 0xFF7F },
+    { "HRAM", 0xFF80, 0xFFFE },
+    { "IE", 0xFFFF, 0xFFFF }
+};
+#define NB_REGIONS (sizeof(REGIONS) / sizeof(REGIONS[0]))
+
+void heatmap_reset(void)
+{
+    memset(&heatmap, 0, sizeof(heatmap));
+}
+
+void heatmap_begin(data_t stat)
+{
+    heatmap.mode = stat & (HEATMAP_LCD_MODES - 1);
+    heatmap.active = true;
+}
+
+// ======================================================================
+#define sum_modes(field, p) \
+    (heatmap.field[0][p] + heatmap.field[1][p] + heatmap.field[2][p] + heatmap.field[3][p])
+
+/**
+ * @brief Sum of counters over a range of pages or of addresses
+ */
+static uint64_t heatmap_sum(const uint64_t counters[HEATMAP_PAGES], unsigned int first, unsigned int last)
+{
+    uint64_t total = 0;
+    for (unsigned int i = first; i <= last; ++i)
+    {
+        total += counters[i];
+    }
+    return total;
+}
+
+static void heatmap_dump_regions(FILE* file)
+{
+    fputs("by region (reads per LCD mode 0/1/2/3, writes per LCD mode 0/1/2/3):\n", file);
+    for (size_t r = 0; r < NB_REGIONS; ++r)
+    {
+        const unsigned int first = heatmap_page(REGIONS[r].start);
+        const unsigned int last = heatmap_page(REGIONS[r].end);
+        if (0xFF == first)
+        {
+            // the last page is counted per address, but not per LCD mode
+            fprintf(file, "  %-14s reads %12" PRIu64 "  writes %12" PRIu64 "\n", REGIONS[r].name,
+                    heatmap_sum(heatmap.io_reads, REGIONS[r].start & 0xFF, REGIONS[r].end & 0xFF),
+                    heatmap_sum(heatmap.io_writes, REGIONS[r].start & 0xFF, REGIONS[r].end & 0xFF));
+            continue;
+        }
+
+        uint64_t reads[HEATMAP_LCD_MODES], writes[HEATMAP_LCD_MODES];
+        for (size_t m = 0; m < HEATMAP_LCD_MODES; ++m)
+        {
+            reads[m] = heatmap_sum(heatmap.reads[m], first, last);
+            writes[m] = heatmap_sum(heatmap.writes[m], first, last);
+        }
+        fprintf(file, "  %-14s reads %12" PRIu64 " (%" PRIu64 "/%" PRIu64 "/%" PRIu64 "/%" PRIu64 ")"
+                "  writes %12" PRIu64 " (%" PRIu64 "/%" PRIu64 "/%" PRIu64 "/%" PRIu64 ")\n",
+                REGIONS[r].name, reads[0] + reads[1] + reads[2] + reads[3], reads[0], reads[1], reads[2], reads[3],
+                writes[0] + writes[1] + writes[2] + writes[3], writes[0], writes[1], writes[2], writes[3]);
+    }
+}
+
+static void heatmap_dump_pages(FILE* file)
+{
+    fputs("\nby page (reads per LCD mode 0/1/2/3, writes per LCD mode 0/1/2/3):\n", file);
+    for (unsigned int p = 0; p < HEATMAP_PAGES; ++p)
+    {
+        const uint64_t reads = sum_modes(reads, p);
+        const uint64_t writes = sum_modes(writes, p);
+        if (reads > 0 || writes > 0)
+        {
+            fprintf(file, "  %02X00-%02XFF  reads %12" PRIu64 " (%" PRIu64 "/%" PRIu64 "/%" PRIu64 "/%" PRIu64 ")"
+                    "  writes %12" PRIu64 " (%" PRIu64 "/%" PRIu64 "/%" PRIu64 "/%" PRIu64 ")\n",
+                    p, p, reads, heatmap.reads[0][p], heatmap.reads[1][p], heatmap.reads[2][p], heatmap.reads[3][p],
+                    writes, heatmap.writes[0][p], heatmap.writes[1][p], heatmap.writes[2][p], heatmap.writes[3][p]);
+        }
+    }
+}
+
+static void heatmap_dump_io(FILE* file)
+{
+    fputs("\nby address, 0xFF00-0xFFFF:\n", file);
+    for (unsigned int a = 0; a < HEATMAP_PAGES; ++a)
+    {
+        if (heatmap.io_reads[a] > 0 || heatmap.io_writes[a] > 0)
+        {
+            fprintf(file, "  FF%02X  reads %12" PRIu64 "  writes %12" PRIu64 "\n",
+                    a, heatmap.io_reads[a], heatmap.io_writes[a]);
+        }
+    }
+}
+
+int heatmap_dump(const char* filename)
+{
+    M_REQUIRE_NON_NULL(filename);
+
+    FILE* file = fopen(filename, "w");
+    if (NULL == file)
+    {
+        return ERR_IO;
+    }
+    heatmap_dump_regions(file);
+    heatmap_dump_pages(file);
+    heatmap_dump_io(file);
+    fclose(file);
+    return ERR_NONE;
+}
+
+#endif
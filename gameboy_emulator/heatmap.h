@@ -0,0 +1,100 @@
+#pragma once
+
+/**
+ * @file heatmap.h
+ * @brief Counters of the bus accesses of the emulated program, per 256 bytes page
+ *        (split by LCD mode) and per address for the I/O registers and HRAM page
+ *
+ * Counting only happens between heatmap_start() and heatmap_stop(), i.e. around
+ * the CPU cycles: accesses of the emulator itself (LCD controller, timer...) are
+ * not counted. Everything vanishes without HEATMAP (heatmap.o is then empty).
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default output file
+#ifndef HEATMAP_OUTPUT
+#define HEATMAP_OUTPUT "heatmap.txt"
+#endif
+
+#define HEATMAP_PAGES 256
+#define HEATMAP_LCD_MODES 4
+#define heatmap_page(address) ((address) >> 8)
+
+/**
+ * @brief Access counters
+ */
+typedef struct {
+    bool active;
+    uint8_t mode;
+    uint64_t reads[HEATMAP_LCD_MODES][HEATMAP_PAGES];
+    uint64_t writes[HEATMAP_LCD_MODES][HEATMAP_PAGES];
+    // per address of the last page (0xFF00 - 0xFFFF)
+    uint64_t io_reads[HEATMAP_PAGES];
+    uint64_t io_writes[HEATMAP_PAGES];
+} heatmap_t;
+
+#ifdef HEATMAP
+// one heatmap per thread, as each thread runs its own Game Boy
+extern _Thread_local heatmap_t heatmap;
+
+
+/**
+ * @brief Resets all the counters
+ */
+void heatmap_reset(void);
+
+
+/**
+ * @brief Starts counting, recording the current LCD mode
+ *
+ * @param stat current value of the STAT register
+ */
+void heatmap_begin(data_t stat);
+
+
+/**
+ * @brief Writes the counters by region, by page and by I/O address
+ *
+ * @param filename file to write to
+ * @return error code
+ */
+int heatmap_dump(const char* filename);
+#endif
+
+
+/**
+ * @brief Macros to count the accesses, vanishing without HEATMAP
+ */
+#ifdef HEATMAP
+#define heatmap_count(counters, io_counters, address) \
+    do { \
+        if (heatmap.active) { \
+            ++heatmap.counters[heatmap.mode][heatmap_page(address)]; \
+            if (0xFF == heatmap_page(address)) ++heatmap.io_counters[(address) & 0xFF]; \
+        } \
+    } while (0)
+#define heatmap_read(address) heatmap_count(reads, io_reads, address)
+#define heatmap_write(address) heatmap_count(writes, io_writes, address)
+#define heatmap_start(stat) heatmap_begin(stat)
+#define heatmap_stop() (heatmap.active = false)
+#else
+#define heatmap_read(address) do {} while (0)
+#define heatmap_write(address) do {} while (0)
+#define heatmap_start(stat) do {} while (0)
+#define heatmap_stop() do {} while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
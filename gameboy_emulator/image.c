@@ -20,6 +20,35 @@
 
 #define do_image_line(piml) do_imlc(piml, lsb); do_imlc(piml, msb); do_imlc(piml, opacity)
 
+#define round_up(size, align) (((size) + (align) - 1) / (align) * (align))
+
+/* An image is a single aligned allocation (starting at its content), made of:
+ *  - its lines;
+ *  - its framebuffer (see image_framebuffer()), as image_t cannot grow;
+ *  - the bit vectors of its lines (lsb, msb and opacity of each line in turn),
+ *    to which the lines point, with a fixed stride;
+ *  - the planes of its framebuffer.
+ * The vectors and the planes are thus copied or cleared as a whole. */
+#define image_fb(pim) ((framebuffer_t*) ((pim)->content + (pim)->height))
+
+typedef struct {
+    size_t vector_stride; // bytes of a bit vector of a line
+    size_t vectors;       // offset of the bit vectors
+    size_t planes;        // offset of the framebuffer planes
+    size_t size;          // size of the allocation
+} image_layout_t;
+
+static image_layout_t image_layout(size_t width, size_t height)
+{
+    image_layout_t layout;
+    layout.vector_stride = round_up(sizeof(bit_vector_t) + size_to_content_size(width) * sizeof(uint32_t),
+                                    sizeof(size_t));
+    layout.vectors = round_up(height * sizeof(image_line_t) + sizeof(framebuffer_t), FRAMEBUFFER_ALIGN);
+    layout.planes = round_up(layout.vectors + 3 * height * layout.vector_stride, FRAMEBUFFER_ALIGN);
+    layout.size = layout.planes + framebuffer_planes_size(width, height);
+    return layout;
+}
+
 // ======================================================================
 #define M_REQUIRE_NON_NULL_IMAGE_LINE(iml)\
     do { \
@@ -83,19 +112,42 @@ int image_line_set_word(image_line_t* piml, size_t index, uint32_t msb, uint32_t
     return ERR_NONE;
 }
 
+// ======================================================================
+/**
+ * @brief Ends an allocating line operation: frees its output on error
+ */
+static int image_line_done(image_line_t* output, int error)
+{
+    if (error != ERR_NONE) {
+        image_line_free(output);
+    }
+    return error;
+}
+
 // ======================================================================
 int image_line_shift(image_line_t* output, image_line_t iml, int64_t shift)
 {
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml);
 
+    const int error = image_line_create(output, iml.msb->size);
+    M_REQUIRE_NO_ERR(error);
+    return image_line_done(output, image_line_shift_into(output, iml, shift));
+}
+
+// ======================================================================
+int image_line_shift_into(image_line_t* output, image_line_t iml, int64_t shift)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(*output, iml);
+
 #define do_imlc(I, X) \
-    I->X = bit_vector_shift(iml.X, shift)
+    M_REQUIRE_NON_NULL(bit_vector_shift_into(I->X, iml.X, shift))
 
     do_image_line(output);
 #undef do_imlc
 
-    return valid(output);
+    return ERR_NONE;
 }
 
 // ======================================================================
@@ -105,13 +157,25 @@ int image_line_extract_wrap_ext(image_line_t* output, image_line_t iml, int64_t
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml);
     M_REQUIRE(size > 0, ERR_BAD_PARAMETER, "%s", "Size argument cannot be zero");
 
+    const int error = image_line_create(output, size);
+    M_REQUIRE_NO_ERR(error);
+    return image_line_done(output, image_line_extract_wrap_ext_into(output, iml, index));
+}
+
+// ======================================================================
+int image_line_extract_wrap_ext_into(image_line_t* output, image_line_t iml, int64_t index)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL_IMAGE_LINE(*output);
+    M_REQUIRE_NON_NULL_IMAGE_LINE(iml);
+
 #define do_imlc(I, X) \
-    I->X = bit_vector_extract_wrap_ext(iml.X, index, size)
+    M_REQUIRE_NON_NULL(bit_vector_extract_wrap_ext_into(I->X, iml.X, index))
 
     do_image_line(output);
 #undef do_imlc
 
-    return valid(output);
+    return ERR_NONE;
 }
 
 // ======================================================================
@@ -120,77 +184,62 @@ int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map)
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml);
 
+    const int error = image_line_create(output, iml.msb->size);
+    M_REQUIRE_NO_ERR(error);
+    return image_line_done(output, image_line_map_colors_into(output, iml, map));
+}
+
+// ======================================================================
+/**
+ * @brief Mask of all ones if bit of palette map is set, zero otherwise
+ */
+#define palette_mask(map, bit) ((uint32_t) 0 - (uint32_t) (((map) >> (bit)) & 1))
+
+int image_line_map_colors_into(image_line_t* output, image_line_t iml, palette_t map)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(*output, iml);
+
+    const size_t words = size_to_content_size(iml.msb->size);
     if (map == DEFAULT_PALETTE) {
+        if (output->msb != iml.msb) {
 #define do_imlc(I, X) \
-        I->X = bit_vector_cpy(iml.X)
+            memcpy(I->X->content, iml.X->content, words * sizeof(uint32_t))
 
-        do_image_line(output);
+            do_image_line(output);
 #undef do_imlc
+        }
         return ERR_NONE;
     }
 
-    output->lsb = bit_vector_create(iml.lsb->size, 0);
-    output->msb = bit_vector_create(iml.msb->size, 0);
-    output->opacity = bit_vector_cpy(iml.opacity);
-
-    for (size_t i = 0; i < PALETTE_COLOR_COUNT; ++i) {
-        bit_vector_t* mask = NULL;
-
-        const bit_t color_bit_0 = (bit_t) (map & (1 << (i * 2    )));
-        const bit_t color_bit_1 = (bit_t) (map & (1 << (i * 2 + 1)));
-
-        if (color_bit_0 || color_bit_1) {
-            switch (i) {
-            case 0: {
-                bit_vector_t* tmp = bit_vector_not(bit_vector_cpy(iml.lsb));
-
-                if (tmp == NULL) {
-                    image_line_free(output);
-                    return ERR_MEM;
-                }
-
-                mask = bit_vector_and(bit_vector_not(bit_vector_cpy(iml.msb)), tmp);
-                bit_vector_free(&tmp);
-            } break;
-
-            case 1: {
-                mask = bit_vector_and(bit_vector_not(bit_vector_cpy(iml.msb)), iml.lsb);
-            } break;
-
-            case 2: {
-                mask = bit_vector_and(bit_vector_not(bit_vector_cpy(iml.lsb)), iml.msb);
-            } break;
-
-            case 3: {
-                mask = bit_vector_and(bit_vector_cpy(iml.lsb), iml.msb);
-            } break;
-            }
-
-            if (mask == NULL) {
-                image_line_free(output);
-                return ERR_MEM;
-            }
-
-            if (color_bit_0) {
-                output->lsb = bit_vector_or(output->lsb, mask);
-
-                if (output->lsb == NULL) {
-                    image_line_free(output);
-                    return ERR_MEM;
-                }
-            }
-
-            if (color_bit_1) {
-                output->msb = bit_vector_or(output->msb, mask);
-
-                if (output->msb == NULL) {
-                    image_line_free(output);
-                    return ERR_MEM;
-                }
-            }
+    /* Each output bit is a function of the msb and lsb bits, given by the palette
+     * (the new color bit of each color): it is computed for 32 pixels at once by
+     * selecting between the masks of the colors, first on lsb then on msb. */
+    const uint32_t lsb_of[PALETTE_COLOR_COUNT] = {
+        palette_mask(map, 0), palette_mask(map, 2), palette_mask(map, 4), palette_mask(map, 6)
+    };
+    const uint32_t msb_of[PALETTE_COLOR_COUNT] = {
+        palette_mask(map, 1), palette_mask(map, 3), palette_mask(map, 5), palette_mask(map, 7)
+    };
+
+    for (size_t i = 0; i < words; ++i) {
+        const uint32_t msb = iml.msb->content[i];
+        const uint32_t lsb = iml.lsb->content[i];
+        const uint32_t lsb_low  = (lsb_of[1] & lsb) | (lsb_of[0] & ~lsb);
+        const uint32_t lsb_high = (lsb_of[3] & lsb) | (lsb_of[2] & ~lsb);
+        const uint32_t msb_low  = (msb_of[1] & lsb) | (msb_of[0] & ~lsb);
+        const uint32_t msb_high = (msb_of[3] & lsb) | (msb_of[2] & ~lsb);
+        output->lsb->content[i] = (lsb_high & msb) | (lsb_low & ~msb);
+        output->msb->content[i] = (msb_high & msb) | (msb_low & ~msb);
+        output->opacity->content[i] = iml.opacity->content[i];
+    }
 
-            bit_vector_free(&mask);
-        }
+    // the colors 0 may have set bits past the size
+    const size_t size = iml.msb->size;
+    if (size % IMAGE_LINE_WORD_BITS != 0) {
+        const uint32_t mask = (UINT32_C(1) << (size % IMAGE_LINE_WORD_BITS)) - 1;
+        output->msb->content[words - 1] &= mask;
+        output->lsb->content[words - 1] &= mask;
     }
 
     return ERR_NONE;
@@ -201,34 +250,28 @@ int image_line_below_with_opacity(image_line_t* output, image_line_t iml1, image
 {
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml1);
-    M_REQUIRE_NON_NULL_IMAGE_LINE(iml2);
-    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(iml1, iml2);
 
-    bit_vector_t* notopacity = bit_vector_not(bit_vector_cpy(p_opacity));
-
-    bit_vector_t* m_above_and_opacity    = bit_vector_and(bit_vector_cpy(iml2.msb), p_opacity );
-    bit_vector_t* l_above_and_opacity    = bit_vector_and(bit_vector_cpy(iml2.lsb), p_opacity );
-    bit_vector_t* m_below_and_notopacity = bit_vector_and(bit_vector_cpy(iml1.msb), notopacity);
-    bit_vector_t* l_below_and_notopacity = bit_vector_and(bit_vector_cpy(iml1.lsb), notopacity);
-
-    if (notopacity == NULL ||
-        m_above_and_opacity == NULL || m_below_and_notopacity == NULL ||
-        l_above_and_opacity == NULL || l_below_and_notopacity == NULL) {
-        bit_vector_free(&notopacity);
-        bit_vector_free(&m_above_and_opacity);
-        bit_vector_free(&m_below_and_notopacity);
-        bit_vector_free(&l_above_and_opacity);
-        bit_vector_free(&l_below_and_notopacity);
-        return ERR_MEM;
-    }
-
-    output->msb     = bit_vector_or(m_below_and_notopacity, m_above_and_opacity);
-    output->lsb     = bit_vector_or(l_below_and_notopacity, l_above_and_opacity);
-    output->opacity = bit_vector_or(bit_vector_cpy(iml1.opacity), p_opacity          );
+    const int error = image_line_create(output, iml1.msb->size);
+    M_REQUIRE_NO_ERR(error);
+    return image_line_done(output, image_line_below_with_opacity_into(output, iml1, iml2, p_opacity));
+}
 
-    bit_vector_free(&notopacity);
-    bit_vector_free(&m_above_and_opacity);
-    bit_vector_free(&l_above_and_opacity);
+// ======================================================================
+int image_line_below_with_opacity_into(image_line_t* output, image_line_t iml1, image_line_t iml2, const bit_vector_t* p_opacity)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(p_opacity);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(iml1, iml2);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(*output, iml1);
+    M_REQUIRE(p_opacity->size == iml1.opacity->size, ERR_BAD_PARAMETER, "%s", "Sizes do not match");
+
+    // word by word, so that the output may be one of the inputs
+    for (size_t i = 0; i < size_to_content_size(p_opacity->size); ++i) {
+        const uint32_t opacity = p_opacity->content[i];
+        output->msb->content[i] = (iml1.msb->content[i] & ~opacity) | (iml2.msb->content[i] & opacity);
+        output->lsb->content[i] = (iml1.lsb->content[i] & ~opacity) | (iml2.lsb->content[i] & opacity);
+        output->opacity->content[i] = iml1.opacity->content[i] | opacity;
+    }
 
     return ERR_NONE;
 }
@@ -244,8 +287,27 @@ int image_line_below(image_line_t* output, image_line_t iml1, image_line_t iml2)
     return image_line_below_with_opacity(output, iml1, iml2, iml2.opacity);
 }
 
+// ======================================================================
+int image_line_below_into(image_line_t* output, image_line_t iml1, image_line_t iml2)
+{
+    M_REQUIRE_NON_NULL_IMAGE_LINE(iml2);
+
+    return image_line_below_with_opacity_into(output, iml1, iml2, iml2.opacity);
+}
+
 // ======================================================================
 int image_line_join(image_line_t* output, image_line_t iml1, image_line_t iml2, int64_t start)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL_IMAGE_LINE(iml1);
+
+    const int error = image_line_create(output, iml1.msb->size);
+    M_REQUIRE_NO_ERR(error);
+    return image_line_done(output, image_line_join_into(output, iml1, iml2, start));
+}
+
+// ======================================================================
+int image_line_join_into(image_line_t* output, image_line_t iml1, image_line_t iml2, int64_t start)
 {
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml1);
@@ -255,27 +317,18 @@ int image_line_join(image_line_t* output, image_line_t iml1, image_line_t iml2,
               "Incorrect sizes in image_line #1 (%zu, %zu, %zu)",
               iml1.lsb->size, iml1.msb->size, iml1.opacity->size);
     M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(iml1, iml2);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(*output, iml1);
     M_REQUIRE(start >= 0, ERR_BAD_PARAMETER, "Incorrect start (%ld < 0)", start);
     M_REQUIRE(start < (int64_t)iml1.msb->size, ERR_BAD_PARAMETER,
               "Incorrect start (%ld >= %zu)", start, iml1.msb->size);
 
-    const int64_t size = (int64_t)iml1.lsb->size;
-
-    if (start % size == 0) {
 #define do_imlc(I, X) \
-        I->X = bit_vector_cpy(iml2.X)
+    M_REQUIRE_NON_NULL(bit_vector_join_into(I->X, iml1.X, iml2.X, start))
 
-        do_image_line(output);
-#undef do_imlc
-    } else {
-#define do_imlc(I, X) \
-        I->X = bit_vector_join(iml1.X, iml2.X, start)
-
-        do_image_line(output);
+    do_image_line(output);
 #undef do_imlc
-    }
 
-    return valid(output);
+    return ERR_NONE;
 }
 
 // ======================================================================
@@ -295,24 +348,49 @@ int image_create(image_t* pim, size_t width, size_t height)
     M_REQUIRE(width > 0, ERR_BAD_PARAMETER, "%s", "Parameter width is zero.");
     M_REQUIRE(height > 0, ERR_BAD_PARAMETER, "%s", "Parameter height is zero.");
 
-    pim->content = calloc(height, sizeof(image_line_t));
-    if (pim->content == NULL) return ERR_MEM;
+    const image_layout_t layout = image_layout(width, height);
+    uint8_t* const base = aligned_alloc(FRAMEBUFFER_ALIGN, layout.size);
+    if (base == NULL) return ERR_MEM;
+    memset(base, 0, layout.size);
 
+    pim->content = (image_line_t*) base;
     pim->height = height;
 
-    int error = ERR_NONE;
-    for (size_t i = 0; i < height && error == ERR_NONE; ++i) {
-        error = image_line_create(pim->content + i, width);
-    }
+    framebuffer_init(image_fb(pim), width, height, base + layout.planes);
+    bit_vector_t* vector = (bit_vector_t*) (base + layout.vectors);
+    for (size_t i = 0; i < height; ++i) {
+#define do_imlc(I, X) \
+        vector->size = width; \
+        I->X = vector; \
+        vector = (bit_vector_t*) ((uint8_t*) vector + layout.vector_stride)
 
-    if (error != ERR_NONE) {
-        image_free(pim);
-        return error;
+        do_image_line((pim->content + i));
+#undef do_imlc
     }
 
     return ERR_NONE;
 }
 
+// ======================================================================
+/**
+ * @brief Unpacks a line into the framebuffer of an image
+ */
+static void image_unpack_line(image_t* pim, size_t y, image_line_t line)
+{
+    const pixel_line_t pl = framebuffer_line(image_fb(pim), y);
+    for (size_t x = 0; x < pl.size; x += 8) {
+        const size_t i = index_to_content_index(x);
+        const unsigned shift = x % IMAGE_LINE_WORD_BITS;
+        uint8_t pixels[8];
+        uint8_t opacity[8];
+        pixel_row_unpack(pixels, (uint8_t) (line.msb->content[i] >> shift), (uint8_t) (line.lsb->content[i] >> shift));
+        pixel_row_unpack(opacity, 0, (uint8_t) (line.opacity->content[i] >> shift));
+        const size_t n = (pl.size - x < 8) ? pl.size - x : 8;
+        memcpy(pl.pixels + x, pixels, n);
+        memcpy(pl.opacity + x, opacity, n);
+    }
+}
+
 // ======================================================================
 int image_set_line(image_t* pim, size_t y, image_line_t line)
 {
@@ -327,6 +405,25 @@ int image_set_line(image_t* pim, size_t y, image_line_t line)
     do_image_line(pim);
 #undef do_imlc
 
+    image_unpack_line(pim, y, line);
+    return ERR_NONE;
+}
+
+// ======================================================================
+int image_set_pixel_line(image_t* pim, size_t y, pixel_line_t line)
+{
+    M_REQUIRE_NON_NULL(pim);
+    M_REQUIRE(y < pim->height, ERR_BAD_PARAMETER, "Invalid Y parameter (%zu < %zu)", y, pim->height);
+    M_REQUIRE_NON_NULL_IMAGE_LINE(pim->content[y]);
+    const pixel_line_t pl = framebuffer_line(image_fb(pim), y);
+    M_REQUIRE(line.size == pl.size, ERR_BAD_PARAMETER, "%s", "Sizes do not match");
+
+    M_REQUIRE_NO_ERR(pixel_line_pack(line, pim->content[y].msb->content, pim->content[y].lsb->content,
+                                     pim->content[y].opacity->content));
+    if (line.pixels != pl.pixels) {
+        memcpy(pl.pixels, line.pixels, pl.size);
+        memcpy(pl.opacity, line.opacity, pl.size);
+    }
     return ERR_NONE;
 }
 
@@ -336,11 +433,10 @@ int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y)
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL(pim);
     M_REQUIRE(y < pim->height, ERR_BAD_PARAMETER, "Invalid Y parameter (%zu >= %zu)", y, pim->height);
-    M_REQUIRE(x < pim->content[y].msb->size, ERR_BAD_PARAMETER, "Invalid X parameter (%zu >= %zu)", x, pim->content[y].msb->size);
-    M_REQUIRE(x < pim->content[y].lsb->size, ERR_BAD_PARAMETER, "Invalid X parameter (%zu >= %zu)", x, pim->content[y].lsb->size);
+    const framebuffer_t* fb = image_fb(pim);
+    M_REQUIRE(x < fb->width, ERR_BAD_PARAMETER, "Invalid X parameter (%zu >= %zu)", x, fb->width);
 
-    *output = (uint8_t)((bit_vector_get(pim->content[y].msb, x) ? 0x2 : 0x0) |
-                        (bit_vector_get(pim->content[y].lsb, x) ? 0x1 : 0x0));
+    *output = framebuffer_pixel(fb, x, y);
 
     return ERR_NONE;
 }
@@ -354,12 +450,55 @@ int image_own_line_content(image_t* pim, size_t y, image_line_t line)
     M_REQUIRE_NON_NULL_IMAGE_LINE(line);
     M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(pim->content[y], line);
 
+    // the line is copied into the image storage, and its vectors freed
+    if (line.msb == pim->content[y].msb) return ERR_NONE;
+    const int error = image_set_line(pim, y, line);
+    image_line_free(&line);
+    return error;
+}
+
+// ======================================================================
+const framebuffer_t* image_framebuffer(const image_t* pim)
+{
+    return (pim == NULL || pim->content == NULL) ? NULL : image_fb(pim);
+}
+
+// ======================================================================
+int image_copy(image_t* dst, const image_t* src)
+{
+    M_REQUIRE_NON_NULL(dst);
+    M_REQUIRE_NON_NULL(src);
+    M_REQUIRE_NON_NULL(dst->content);
+    M_REQUIRE_NON_NULL(src->content);
+    const framebuffer_t* fb = image_fb(src);
+    M_REQUIRE(dst->height == src->height && image_fb(dst)->width == fb->width, ERR_BAD_PARAMETER,
+              "Sizes do not match (%zux%zu, %zux%zu)", image_fb(dst)->width, dst->height, fb->width, src->height);
+
+    if (dst != src) {
+        // the vectors of the lines and the planes (the vector sizes being the same)
+        const image_layout_t layout = image_layout(fb->width, src->height);
+        memcpy((uint8_t*) dst->content + layout.vectors, (const uint8_t*) src->content + layout.vectors,
+               layout.size - layout.vectors);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+int image_clear(image_t* pim)
+{
+    M_REQUIRE_NON_NULL(pim);
+    M_REQUIRE_NON_NULL(pim->content);
+
+    const size_t width = image_fb(pim)->width;
+    const image_layout_t layout = image_layout(width, pim->height);
+    memset((uint8_t*) pim->content + layout.vectors, 0, layout.size - layout.vectors);
+    for (size_t i = 0; i < pim->height; ++i) {
 #define do_imlc(I, X) \
-    bit_vector_free(&(I->content[y].X)); \
-    I->content[y].X = line.X
+        I->X->size = width
 
-    do_image_line(pim);
+        do_image_line((pim->content + i));
 #undef do_imlc
+    }
     return ERR_NONE;
 }
 
@@ -368,10 +507,7 @@ void image_free(image_t* pim)
 {
     if (pim == NULL) return;
 
-    for (size_t i = 0; i < pim->height; ++i) {
-        image_line_free(pim->content + i);
-    }
-
+    // the lines, their vectors and the framebuffer are in the same allocation
     pim->height = 0;
     free(pim->content);
     pim->content = NULL;
@@ -13,6 +13,7 @@ extern "C" {
 #endif
 
 #include "bit_vector.h"
+#include "framebuffer.h"
 
 #include <stdint.h>
 
@@ -39,7 +40,11 @@ typedef struct image_line_ image_line_t;
 
 //=========================================================================
 /**
- * @brief Type to represent images
+ * @brief Type to represent images.
+ *        Besides its lines, an image keeps its pixels in a framebuffer
+ *        (see image_framebuffer()), updated when a line is set.
+ *        Lines and framebuffer are stored in a single allocation: the
+ *        vectors of the lines belong to the image and must not be freed.
  */
 struct image_ {
     size_t height;
@@ -77,6 +82,16 @@ int image_line_set_word(image_line_t* piml, size_t index, uint32_t msb, uint32_t
  */
 int image_line_shift(image_line_t* output, image_line_t iml, int64_t shift);
 
+//=========================================================================
+/**
+ * @brief Shift image line into an existing line (no allocation)
+ * @param output pointer to the line to write, of the size of iml (not iml)
+ * @param iml image line to shift
+ * @param shift shift amount
+ * @return Error code
+ */
+int image_line_shift_into(image_line_t* output, image_line_t iml, int64_t shift);
+
 //=========================================================================
 /**
  * @brief Extract image line (wrapping)
@@ -88,6 +103,16 @@ int image_line_shift(image_line_t* output, image_line_t iml, int64_t shift);
  */
 int image_line_extract_wrap_ext(image_line_t* output, image_line_t iml, int64_t index, size_t size);
 
+//=========================================================================
+/**
+ * @brief Extract image line (wrapping) into an existing line (no allocation)
+ * @param output pointer to the line to write, of the size to extract (not iml)
+ * @param iml image line to extract
+ * @param index index from which to extract
+ * @return Error code
+ */
+int image_line_extract_wrap_ext_into(image_line_t* output, image_line_t iml, int64_t index);
+
 //=========================================================================
 /**
  * @brief Apply Palette to image line
@@ -98,6 +123,16 @@ int image_line_extract_wrap_ext(image_line_t* output, image_line_t iml, int64_t
  */
 int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map);
 
+//=========================================================================
+/**
+ * @brief Apply Palette to image line into an existing line (no allocation)
+ * @param output pointer to the line to write, of the size of iml (may be iml)
+ * @param iml image line to use palette on
+ * @param map palette to use
+ * @return Error code
+ */
+int image_line_map_colors_into(image_line_t* output, image_line_t iml, palette_t map);
+
 //=========================================================================
 /**
  * @brief Combine two image lines using opacity
@@ -109,6 +144,17 @@ int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map)
  */
 int image_line_below_with_opacity(image_line_t* output, image_line_t iml1, image_line_t iml2, bit_vector_t* p_opacity);
 
+//=========================================================================
+/**
+ * @brief Combine two image lines using opacity into an existing line (no allocation)
+ * @param output pointer to the line to write, of the size of iml1 (may be iml1 or iml2)
+ * @param iml1 image line to combine
+ * @param iml2 image line to combine
+ * @param p_opacity bit vector pointer to use for opacity
+ * @return Error code
+ */
+int image_line_below_with_opacity_into(image_line_t* output, image_line_t iml1, image_line_t iml2, const bit_vector_t* p_opacity);
+
 //=========================================================================
 /**
  * @brief Combine two image lines (using iml2 opacity)
@@ -119,6 +165,16 @@ int image_line_below_with_opacity(image_line_t* output, image_line_t iml1, image
  */
 int image_line_below(image_line_t* output, image_line_t iml1, image_line_t iml2);
 
+//=========================================================================
+/**
+ * @brief Combine two image lines (using iml2 opacity) into an existing line (no allocation)
+ * @param output pointer to the line to write, of the size of iml1 (may be iml1 or iml2)
+ * @param iml1 image line to combine
+ * @param iml2 image line to combine
+ * @return Error code
+ */
+int image_line_below_into(image_line_t* output, image_line_t iml1, image_line_t iml2);
+
 //=========================================================================
 /**
  * @brief Join two image lines
@@ -130,6 +186,17 @@ int image_line_below(image_line_t* output, image_line_t iml1, image_line_t iml2)
  */
 int image_line_join(image_line_t* output, image_line_t iml1, image_line_t iml2, int64_t start);
 
+//=========================================================================
+/**
+ * @brief Join two image lines into an existing line (no allocation)
+ * @param output pointer to the line to write, of the size of iml1 (may be iml1 or iml2)
+ * @param iml1 image line to join (values from 0 to start)
+ * @param iml2 image line to join (values from start to end)
+ * @param start index from which to use iml2 values
+ * @return Error code
+ */
+int image_line_join_into(image_line_t* output, image_line_t iml1, image_line_t iml2, int64_t start);
+
 //=========================================================================
 /**
  * @brief Free image line
@@ -157,6 +224,16 @@ int image_create(image_t* pim, size_t width, size_t height);
  */
 int image_set_line(image_t* pim, size_t y, image_line_t line);
 
+//=========================================================================
+/**
+ * @brief Set line content of image from a line of pixels (copying values)
+ * @param pim pointer to image
+ * @param y line index
+ * @param line line of pixels of the width of the image
+ * @return Error code
+ */
+int image_set_pixel_line(image_t* pim, size_t y, pixel_line_t line);
+
 //=========================================================================
 /**
  * @brief Get pixel value from image
@@ -170,7 +247,8 @@ int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y);
 
 //=========================================================================
 /**
- * @brief Set line content of image (using provided bit vectors pointers)
+ * @brief Set line content of image, taking ownership of the provided bit vectors
+ *        (their content is copied into the image and they are freed)
  * @param pim pointer to image
  * @param y line index to set
  * @param line line to use bit vectors from
@@ -178,6 +256,31 @@ int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y);
  */
 int image_own_line_content(image_t* pim, size_t y, image_line_t line);
 
+//=========================================================================
+/**
+ * @brief Get the framebuffer of an image (one byte per pixel, see framebuffer.h)
+ * @param pim pointer to image
+ * @return the framebuffer (NULL if pim is NULL or not created)
+ */
+const framebuffer_t* image_framebuffer(const image_t* pim);
+
+//=========================================================================
+/**
+ * @brief Copy the content of an image into another image of the same size
+ * @param dst pointer to the image to write
+ * @param src pointer to the image to copy
+ * @return Error code
+ */
+int image_copy(image_t* dst, const image_t* src);
+
+//=========================================================================
+/**
+ * @brief Clear an image (all pixels of color 0 and transparent)
+ * @param pim pointer to image
+ * @return Error code
+ */
+int image_clear(image_t* pim);
+
 //=========================================================================
 /**
  * @brief Free image
@@ -0,0 +1,117 @@
+/**
+ * @file joypad.c
+ * @brief Game Boy joypad simulation
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include "joypad.h"
+#include "bit.h"
+#include "error.h"
+
+#include <assert.h>
+#include <string.h> // memset
+
+// P1 bits 4 and 5 select the key rows (0 = selected)
+#define P1_ROW_SELECT_BIT 4
+#define P1_ROW_SELECT_MASK 0x30
+
+// ======================================================================
+/**
+ * @brief Computes the state of the keys of the selected rows
+ *        (1 = pressed, on the 4 lsb)
+ */
+static uint8_t compute_state(const joypad_t* pad)
+{
+    assert(pad != NULL);
+
+    uint8_t state = 0;
+    for (int row = 0; row < NB_GB_KEY_ROWS; ++row) {
+        if (bit_get(*pad->p_P1, P1_ROW_SELECT_BIT + row) != 1) {
+            state |= pad->keys_state[row];
+        }
+    }
+    return lsb4(state);
+}
+
+// ======================================================================
+/**
+ * @brief Computes the state of the keys, requesting the joypad interrupt
+ *        if a key of the selected rows was newly pressed
+ */
+static uint8_t joypad_request_interrupt(joypad_t* pad)
+{
+    assert(pad != NULL);
+
+    const uint8_t state = compute_state(pad);
+    if (state & ~pad->old_state) {
+        cpu_request_interrupt(pad->cpu, JOYPAD);
+    }
+    return state;
+}
+
+// ======================================================================
+/**
+ * @brief Exposes the given key state on P1 (where pressed keys read as 0)
+ *        and remembers it
+ */
+static void update_P1(joypad_t* pad, uint8_t state)
+{
+    // the upper bits of ~state also set the (unused) upper bits of P1
+    pad->intern = (data_t)((pad->intern & 0xF0) | ~state);
+    *pad->p_P1 = pad->intern;
+    pad->old_state = state;
+}
+
+// ==== see joypad.h ========================================
+int joypad_init_and_plug(joypad_t* pad, cpu_t* cpu)
+{
+    M_REQUIRE_NON_NULL(pad);
+    M_REQUIRE_NON_NULL(cpu);
+
+    memset(pad, 0, sizeof(joypad_t));
+    pad->cpu = cpu;
+    pad->p_P1 = (*cpu->bus)[REG_P1];
+    M_REQUIRE_NON_NULL(pad->p_P1);
+
+    pad->intern = 0xC0;
+    update_P1(pad, compute_state(pad));
+    return ERR_NONE;
+}
+
+// ==== see joypad.h ========================================
+int joypad_bus_listener(joypad_t* pad, addr_t addr)
+{
+    M_REQUIRE_NON_NULL(pad);
+
+    if (REG_P1 == addr) {
+        // only the row selection can be written
+        pad->intern = (data_t)((pad->intern & ~P1_ROW_SELECT_MASK) | (*pad->p_P1 & P1_ROW_SELECT_MASK));
+        *pad->p_P1 = pad->intern;
+        update_P1(pad, joypad_request_interrupt(pad));
+    }
+    return ERR_NONE;
+}
+
+// ==== see joypad.h ========================================
+int joypad_key_pressed(joypad_t* pad, gb_key_t key)
+{
+    M_REQUIRE_NON_NULL(pad);
+    M_REQUIRE((unsigned) key < NB_GB_KEYS, ERR_BAD_PARAMETER, "unknown key %d", key);
+
+    bit_set(&pad->keys_state[key / NB_GB_KEY_COLS], key % NB_GB_KEY_COLS);
+    update_P1(pad, joypad_request_interrupt(pad));
+    return ERR_NONE;
+}
+
+// ==== see joypad.h ========================================
+int joypad_key_released(joypad_t* pad, gb_key_t key)
+{
+    M_REQUIRE_NON_NULL(pad);
+    M_REQUIRE((unsigned) key < NB_GB_KEYS, ERR_BAD_PARAMETER, "unknown key %d", key);
+
+    bit_unset(&pad->keys_state[key / NB_GB_KEY_COLS], key % NB_GB_KEY_COLS);
+    update_P1(pad, compute_state(pad));
+    return ERR_NONE;
+}
@@ -0,0 +1,816 @@
+/**
+ * @file lcdc.c
+ * @brief Game Boy LCD (liquid cristal display) controller simulation
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include "gameboy.h" // includes lcdc.h after the types it needs
+#include "lcdc.h"
+#include "cpu.h"
+#include "bit.h"
+#include "image.h"
+#include "error.h"
+
+#include <assert.h>
+#include <inttypes.h> // PRIu64
+#include <string.h> // memset
+
+#ifdef LCDC_THREAD
+#include <errno.h>
+#include <sched.h> // sched_yield
+#endif
+
+// Sprites (objects), described in OAM
+
+#define OAM_START GRAPH_RAM_START
+#define OAM_END   GRAPH_RAM_END
+
+#define SPRITE_COUNT      40
+#define SPRITE_ENTRY_SIZE 4
+
+#define SPRITE_OFFSET_Y 16
+#define SPRITE_OFFSET_X 8
+
+#define SPRITE_Y     0
+#define SPRITE_X     1
+#define SPRITE_TILE  2
+#define SPRITE_FLAGS 3
+
+#define SPRITE_FLAG_PALETTE_MASK 0x10
+#define SPRITE_FLAG_FLIP_X_MASK  0x20
+#define SPRITE_FLAG_FLIP_Y_MASK  0x40
+#define SPRITE_FLAG_BEHIND_MASK  0x80
+
+// STAT interrupt enable bits, for modes 0 to 2
+#define STAT_REG_INT_MODE_BIT 3
+
+#define DMA_START OAM_START
+#define DMA_END   OAM_END
+#define DMA_SIZE  (DMA_END - DMA_START + 1)
+
+// the controller accesses its registers and the video memory directly:
+// these are not CPU bus accesses
+#define LCD_MEM(lcd, addr) (*(*(lcd)->cpu->bus)[addr])
+
+#define LCD_REG_BIT(lcd, mask) (LCD_MEM(lcd, REG_LCDC) & (mask))
+
+// the renderer only reads its own copies
+#define RENDER_VRAM(r, addr) ((r)->video_ram[(addr) - VIDEO_RAM_START])
+#define RENDER_REG(r, reg)   ((r)->regs[(reg) - REG_LCDC])
+
+#define RENDER_REG_BIT(r, mask) (RENDER_REG(r, REG_LCDC) & (mask))
+
+#define sprite_attr(r, sprite, attr) \
+    ((r)->oam[(sprite) * SPRITE_ENTRY_SIZE + (attr)])
+
+#define sprite_height(r) (RENDER_REG_BIT(r, LCDC_REG_OBJ_SIZE_MASK) ? 16 : 8)
+
+// ======================================================================
+/**
+ * @brief Commands to the renderer, of 32 bits: kind, value and address
+ */
+typedef enum {
+    RENDER_WRITE,     // a byte of video memory or a register
+    RENDER_FRAME,     // start of a frame
+    RENDER_LINE,      // a line to render (value: y)
+    RENDER_FRAME_END, // end of a rendered frame: hashes the display
+    RENDER_SYNC,      // posts synced once all the previous ones are done
+    RENDER_STOP       // ends the render thread
+} render_kind_t;
+
+#define render_command(kind, value, addr) \
+    ((uint32_t)(kind) << 24 | (uint32_t)(value) << 16 | (uint32_t)(addr))
+
+#define command_kind(command)  ((render_kind_t)((command) >> 24))
+#define command_value(command) ((data_t)((command) >> 16))
+#define command_addr(command)  ((addr_t)(command))
+
+// the registers the renderer reads
+static const addr_t RENDERED_REGS[] = {
+    REG_LCDC, REG_SCY, REG_SCX, REG_BGP, REG_OBP0, REG_OBP1, REG_WY, REG_WX
+};
+
+// ======================================================================
+/**
+ * @brief Sets the mode of the controller in STAT, requesting the
+ *        LCD_STAT interrupt if enabled for this mode
+ */
+static void set_mode(lcdc_t* lcd, uint8_t mode)
+{
+    data_t* const stat = (*lcd->cpu->bus)[REG_STAT];
+    *stat = (data_t)((*stat & ~STAT_REG_MODE_MASK) | (mode & STAT_REG_MODE_MASK));
+    if (mode <= 2 && bit_get(*stat, STAT_REG_INT_MODE_BIT + mode)) {
+        cpu_request_interrupt(lcd->cpu, LCD_STAT);
+    }
+}
+
+// ======================================================================
+/**
+ * @brief Updates the LYC=LY bit of STAT, requesting the LCD_STAT
+ *        interrupt if enabled and equal
+ */
+static void update_lyc(lcdc_t* lcd)
+{
+    const bit_t equal = LCD_MEM(lcd, REG_LY) == LCD_MEM(lcd, REG_LYC);
+    bit_edit((*lcd->cpu->bus)[REG_STAT], STAT_REG_LYC_EQ_LY_BIT, equal);
+    if (equal && bit_get(LCD_MEM(lcd, REG_STAT), STAT_REG_INT_LYC_BIT)) {
+        cpu_request_interrupt(lcd->cpu, LCD_STAT);
+    }
+}
+
+// ======================================================================
+/**
+ * @brief Reverses the bits of a byte: tiles have their leftmost pixel
+ *        in bit 7, image lines in bit 0
+ */
+static uint8_t reverse_bits(uint8_t byte)
+{
+    byte = (uint8_t)((byte & 0xF0) >> 4 | (byte & 0x0F) << 4);
+    byte = (uint8_t)((byte & 0xCC) >> 2 | (byte & 0x33) << 2);
+    byte = (uint8_t)((byte & 0xAA) >> 1 | (byte & 0x55) << 1);
+    return byte;
+}
+
+// ======================================================================
+/**
+ * @brief Writes a byte of the copy of the renderer, invalidating what is
+ *        derived from it: the tile row holding it, or the index of the sprites
+ */
+static void renderer_write(lcdc_renderer_t* r, addr_t addr, data_t data)
+{
+    if (addr >= VIDEO_RAM_START && addr <= VIDEO_RAM_END) {
+        RENDER_VRAM(r, addr) = data;
+        if (addr <= TILE_DATA_END) {
+            const size_t index = (size_t)(addr - TILE_SRC_ADDR_LOW) / 2;
+            r->tile_rows_dirty[index / 64] |= UINT64_C(1) << (index % 64);
+        }
+    } else if (addr >= OAM_START && addr <= OAM_END) {
+        r->oam[addr - OAM_START] = data;
+        r->sprite_index_height = 0;
+    } else {
+        assert(addr >= REG_LCDC && addr <= REG_WX);
+        RENDER_REG(r, addr) = data;
+    }
+}
+
+// ======================================================================
+/**
+ * @brief Gets a decoded tile row, decoding it first if it was written
+ *
+ * @param source base address of the tiles
+ * @param tile tile index (from source)
+ * @param y row in the tile
+ */
+static const tile_row_t* tile_row(lcdc_renderer_t* r, addr_t source, uint8_t tile, uint8_t y)
+{
+    const size_t index = (size_t)(source - TILE_SRC_ADDR_LOW) / 2 + tile * (TILE_SIZE / 2) + y;
+    assert(index < TILE_ROW_COUNT);
+
+    uint64_t* const dirty = &r->tile_rows_dirty[index / 64];
+    const uint64_t mask = UINT64_C(1) << (index % 64);
+    if (*dirty & mask) {
+        const addr_t addr = (addr_t)(TILE_SRC_ADDR_LOW + index * 2);
+        const uint8_t lsb = reverse_bits(RENDER_VRAM(r, addr));
+        const uint8_t msb = reverse_bits(RENDER_VRAM(r, addr + 1));
+        pixel_row_unpack(r->tile_rows[index].pixels, msb, lsb);
+        // the pixels of color 0 are transparent
+        pixel_row_unpack(r->tile_rows[index].opacity, 0, msb | lsb);
+        *dirty &= ~mask;
+    }
+    return &r->tile_rows[index];
+}
+
+// ======================================================================
+/**
+ * @brief Pixels of a line being rendered, up to a row of a tile map
+ */
+typedef struct {
+    _Alignas(FRAMEBUFFER_ALIGN) uint8_t pixels[TILE_LINE_SIZE * 8];
+    _Alignas(FRAMEBUFFER_ALIGN) uint8_t opacity[TILE_LINE_SIZE * 8];
+} line_buffer_t;
+
+#define buffer_line(buffer, width) ((pixel_line_t) { (buffer).pixels, (buffer).opacity, (width) })
+
+// ======================================================================
+/**
+ * @brief Builds a row of pixels of the background (or window) tile map
+ *
+ * @param line line to write, of 8 pixels per tile to read
+ * @param high_area whether to use the high tile map
+ * @param y row (in pixels) in the tile map
+ */
+static void build_tile_line(pixel_line_t line, lcdc_renderer_t* r, bit_t high_area, uint8_t y)
+{
+    const addr_t map = high_area ? TILE_ADDR_BASE_HIGH : TILE_ADDR_BASE_LOW;
+    const bit_t low_source = RENDER_REG_BIT(r, LCDC_REG_TILE_SOURCE_MASK) != 0;
+    const addr_t source = low_source ? TILE_SRC_ADDR_LOW : TILE_SRC_ADDR_HIGH;
+    const addr_t row = (addr_t)(map + (y / 8) * TILE_LINE_SIZE);
+
+    for (size_t k = 0; k < line.size / 8; ++k) {
+        uint8_t tile = RENDER_VRAM(r, row + k);
+        if (!low_source) {
+            // signed indices, from 0x9000
+            tile = (uint8_t)(tile + 0x80);
+        }
+        const tile_row_t* const decoded = tile_row(r, source, tile, y % 8);
+        memcpy(line.pixels + 8 * k, decoded->pixels, sizeof(decoded->pixels));
+        memcpy(line.opacity + 8 * k, decoded->opacity, sizeof(decoded->opacity));
+    }
+}
+
+// ======================================================================
+/**
+ * @brief Renders the background of line y
+ */
+static int render_background(pixel_line_t line, lcdc_renderer_t* r, uint8_t y)
+{
+    line_buffer_t buffer;
+    const pixel_line_t background = buffer_line(buffer, TILE_LINE_SIZE * 8);
+    build_tile_line(background, r, RENDER_REG_BIT(r, LCDC_REG_BG_AREA_MASK) != 0,
+                    (uint8_t)(RENDER_REG(r, REG_SCY) + y));
+
+    M_REQUIRE_NO_ERR(pixel_line_extract_wrap(line, background, RENDER_REG(r, REG_SCX)));
+    return pixel_line_map_colors(line, line, RENDER_REG(r, REG_BGP));
+}
+
+// ======================================================================
+/**
+ * @brief Draws the window of line y over the given (background) line
+ */
+static int render_window(pixel_line_t line, lcdc_renderer_t* r, uint8_t y)
+{
+    const data_t wx = RENDER_REG(r, REG_WX);
+    const uint8_t x = (uint8_t)(wx - WINDOW_OFFSET_X);
+    if (wx < WINDOW_OFFSET_X || x >= LCD_WIDTH
+        || !RENDER_REG_BIT(r, LCDC_REG_WIN_MASK) || y < RENDER_REG(r, REG_WY)) {
+        return ERR_NONE;
+    }
+
+    line_buffer_t buffer;
+    const pixel_line_t window = buffer_line(buffer, VISIBLE_LINE_SIZE * 8);
+    build_tile_line(window, r, RENDER_REG_BIT(r, LCDC_REG_WIN_AREA_MASK) != 0, r->window_y);
+    M_REQUIRE_NO_ERR(pixel_line_map_colors(window, window, RENDER_REG(r, REG_BGP)));
+
+    line_buffer_t moved_buffer;
+    const pixel_line_t moved = buffer_line(moved_buffer, LCD_WIDTH);
+    M_REQUIRE_NO_ERR(pixel_line_shift(moved, window, x));
+    M_REQUIRE_NO_ERR(pixel_line_join(line, moved, line, x));
+
+    ++r->window_y;
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief Rebuilds the index of the sprites of each line: the (at most
+ *        SPRITES_PER_LINE_MAX first) sprites on the line, sorted by priority
+ *        (x position, then OAM index)
+ */
+static void index_sprites(lcdc_renderer_t* r)
+{
+    const uint8_t height = sprite_height(r);
+    memset(r->line_sprite_count, 0, sizeof(r->line_sprite_count));
+
+    for (uint8_t i = 0; i < SPRITE_COUNT; ++i) {
+        const uint8_t top = (uint8_t)(sprite_attr(r, i, SPRITE_Y) - SPRITE_OFFSET_Y);
+        const data_t x = sprite_attr(r, i, SPRITE_X);
+        for (int y = top; y < top + height && y < LCD_HEIGHT; ++y) {
+            uint8_t* const count = &r->line_sprite_count[y];
+            if (*count == SPRITES_PER_LINE_MAX) {
+                continue;
+            }
+            // insertion sort: the sprites already there have lower indices
+            uint8_t* const sprites = r->line_sprites[y];
+            uint8_t k = *count;
+            for (; k > 0 && sprite_attr(r, sprites[k - 1], SPRITE_X) > x; --k) {
+                sprites[k] = sprites[k - 1];
+            }
+            sprites[k] = i;
+            ++*count;
+        }
+    }
+    r->sprite_index_height = height;
+}
+
+// ======================================================================
+/**
+ * @brief Draws a sprite of line y under the sprites already drawn
+ *        on the line (which have priority)
+ */
+static void draw_sprite(pixel_line_t line, lcdc_renderer_t* r, uint8_t sprite, uint8_t y)
+{
+    const data_t flags = sprite_attr(r, sprite, SPRITE_FLAGS);
+    const uint8_t x = (uint8_t)(sprite_attr(r, sprite, SPRITE_X) - SPRITE_OFFSET_X);
+    uint8_t row = (uint8_t)(y - (uint8_t)(sprite_attr(r, sprite, SPRITE_Y) - SPRITE_OFFSET_Y));
+    if (flags & SPRITE_FLAG_FLIP_Y_MASK) {
+        row = (uint8_t)(sprite_height(r) - 1 - row);
+    }
+    const tile_row_t* const decoded = tile_row(r, TILE_SRC_ADDR_LOW, sprite_attr(r, sprite, SPRITE_TILE), row);
+    const palette_t palette = RENDER_REG(r, flags & SPRITE_FLAG_PALETTE_MASK ? REG_OBP1 : REG_OBP0);
+
+    for (size_t i = 0; i < 8 && x + i < line.size; ++i) {
+        if (!line.opacity[x + i]) {
+            const size_t from = (flags & SPRITE_FLAG_FLIP_X_MASK) ? 7 - i : i;
+            line.pixels[x + i] = (uint8_t)((palette >> (2 * decoded->pixels[from])) & 0x3);
+            line.opacity[x + i] = decoded->opacity[from];
+        }
+    }
+}
+
+// ======================================================================
+/**
+ * @brief Draws the sprites of line y over the given (background) line
+ */
+static int render_all_sprites(pixel_line_t line, lcdc_renderer_t* r, uint8_t y)
+{
+    if (r->sprite_index_height != sprite_height(r)) {
+        index_sprites(r);
+    }
+    const uint8_t* const sprites = r->line_sprites[y];
+    const uint8_t count = r->line_sprite_count[y];
+
+    // all the sprites, and only those in front of the background
+    line_buffer_t all_buffer;
+    line_buffer_t front_buffer;
+    memset(&all_buffer, 0, sizeof(all_buffer));
+    memset(&front_buffer, 0, sizeof(front_buffer));
+    const pixel_line_t all = buffer_line(all_buffer, LCD_WIDTH);
+    const pixel_line_t front = buffer_line(front_buffer, LCD_WIDTH);
+    for (uint8_t i = 0; i < count; ++i) {
+        draw_sprite(all, r, sprites[i], y);
+        if (!(sprite_attr(r, sprites[i], SPRITE_FLAGS) & SPRITE_FLAG_BEHIND_MASK)) {
+            draw_sprite(front, r, sprites[i], y);
+        }
+    }
+
+    // the sprites behind the background only show on its color 0,
+    // 8 pixels (of opacity 0 or 1) at a time
+    uint8_t background_shown[LCD_WIDTH];
+    for (size_t x = 0; x < LCD_WIDTH; x += 8) {
+        uint64_t background = 0;
+        uint64_t sprite = 0;
+        memcpy(&background, line.opacity + x, sizeof(background));
+        memcpy(&sprite, all.opacity + x, sizeof(sprite));
+        const uint64_t shown = background | (sprite ^ UINT64_C(0x0101010101010101));
+        memcpy(background_shown + x, &shown, sizeof(shown));
+    }
+    M_REQUIRE_NO_ERR(pixel_line_below_with_opacity(line, all, line, background_shown));
+    return pixel_line_below(line, line, front);
+}
+
+// ======================================================================
+/**
+ * @brief Renders line y of the display (the background being on)
+ */
+static int render_line(lcdc_renderer_t* r, uint8_t y)
+{
+    line_buffer_t buffer;
+    const pixel_line_t line = buffer_line(buffer, LCD_WIDTH);
+
+    M_REQUIRE_NO_ERR(render_background(line, r, y));
+    M_REQUIRE_NO_ERR(render_window(line, r, y));
+    if (RENDER_REG_BIT(r, LCDC_REG_OBJ_MASK)) {
+        M_REQUIRE_NO_ERR(render_all_sprites(line, r, y));
+    }
+    return image_set_pixel_line(r->display, y, line);
+}
+
+// ======================================================================
+/**
+ * @brief Runs a command of the controller (but sync and stop, which
+ *        only concern the render thread)
+ */
+static int renderer_run(lcdc_renderer_t* r, uint32_t command)
+{
+    switch (command_kind(command)) {
+    case RENDER_WRITE:
+        renderer_write(r, command_addr(command), command_value(command));
+        break;
+
+    case RENDER_FRAME:
+        r->window_y = 0;
+        break;
+
+    case RENDER_LINE:
+        return render_line(r, command_value(command));
+
+    case RENDER_FRAME_END:
+        *r->frame_hash = framebuffer_hash(image_framebuffer(r->display));
+        break;
+
+    default:
+        break;
+    }
+    return ERR_NONE;
+}
+
+#ifdef LCDC_THREAD
+// ======================================================================
+/**
+ * @brief Render thread: runs the commands of the queue as they come
+ */
+static void* render_thread(void* arg)
+{
+    lcdc_t* const lcd = arg;
+    for (;;) {
+        while (sem_wait(&lcd->submitted) != 0 && errno == EINTR) {}
+
+        // everything pushed before the post is there: no command is left behind
+        uint32_t command = 0;
+        while (spsc_queue_pop(&lcd->queue, &command)) {
+            switch (command_kind(command)) {
+            case RENDER_SYNC:
+                sem_post(&lcd->synced);
+                break;
+
+            case RENDER_STOP:
+                return NULL;
+
+            default: {
+                const int err = renderer_run(&lcd->renderer, command);
+                if (err != ERR_NONE && lcd->render_error == ERR_NONE) {
+                    lcd->render_error = err;
+                }
+            } break;
+            }
+        }
+    }
+}
+#endif
+
+// ======================================================================
+/**
+ * @brief Submits a command to the renderer: runs it, or queues it for
+ *        the render thread
+ */
+static int submit(lcdc_t* lcd, uint32_t command)
+{
+#ifdef LCDC_THREAD
+    const render_kind_t kind = command_kind(command);
+    while (!spsc_queue_push(&lcd->queue, command)) {
+        // the renderer is a whole queue behind: make sure it runs
+        sem_post(&lcd->submitted);
+        sched_yield();
+    }
+    // the render thread is woken up for batches of lines, at the latest
+    // on the last line of the frame
+    const bit_t last_of_batch = kind == RENDER_LINE
+                                && (command_value(command) % LCDC_BATCH_LINES == LCDC_BATCH_LINES - 1
+                                    || command_value(command) == LCD_HEIGHT - 1);
+    if (last_of_batch || kind == RENDER_SYNC || kind == RENDER_STOP) {
+        sem_post(&lcd->submitted);
+    }
+    return ERR_NONE;
+#else
+    return renderer_run(&lcd->renderer, command);
+#endif
+}
+
+// ======================================================================
+/**
+ * @brief Marks a byte of video memory (or OAM) as written, to be sent
+ *        to the renderer with the next line
+ */
+static void mark_written(lcdc_t* lcd, addr_t addr)
+{
+    size_t index = 0;
+    if (addr >= VIDEO_RAM_START && addr <= VIDEO_RAM_END) {
+        index = (size_t)(addr - VIDEO_RAM_START);
+    } else if (addr >= OAM_START && addr <= OAM_END) {
+        index = LCD_VRAM_SIZE + (size_t)(addr - OAM_START);
+    } else {
+        return;
+    }
+    lcd->written[index / 64] |= UINT64_C(1) << (index % 64);
+    lcd->any_written = true;
+}
+
+// ======================================================================
+/**
+ * @brief Submits line y to the renderer, after the bytes of video memory
+ *        written and the registers changed since the previous one
+ */
+static int submit_line(lcdc_t* lcd, uint8_t y)
+{
+    if (lcd->any_written) {
+        for (size_t i = 0; i < sizeof(lcd->written) / sizeof(lcd->written[0]); ++i) {
+            for (uint64_t bits = lcd->written[i]; bits != 0; bits &= bits - 1) {
+                const size_t index = i * 64 + (size_t) __builtin_ctzll(bits);
+                const addr_t addr = (addr_t)(index < LCD_VRAM_SIZE ? VIDEO_RAM_START + index
+                                             : OAM_START + index - LCD_VRAM_SIZE);
+                M_REQUIRE_NO_ERR(submit(lcd, render_command(RENDER_WRITE, LCD_MEM(lcd, addr), addr)));
+            }
+            lcd->written[i] = 0;
+        }
+        lcd->any_written = false;
+    }
+
+    for (size_t i = 0; i < sizeof(RENDERED_REGS) / sizeof(RENDERED_REGS[0]); ++i) {
+        const addr_t reg = RENDERED_REGS[i];
+        data_t* const sent = &lcd->sent_regs[reg - REG_LCDC];
+        if (LCD_MEM(lcd, reg) != *sent) {
+            *sent = LCD_MEM(lcd, reg);
+            M_REQUIRE_NO_ERR(submit(lcd, render_command(RENDER_WRITE, *sent, reg)));
+        }
+    }
+    return submit(lcd, render_command(RENDER_LINE, y, 0));
+}
+
+// ======================================================================
+/**
+ * @brief Whether the frame starting at the given cycle is rendered
+ */
+static bool frame_rendered(const lcdc_t* lcd, uint64_t cycle)
+{
+    switch (lcd->render_policy) {
+    case LCDC_RENDER_EVERY_NTH:
+        return lcd->frame_count % lcd->render_period == 0;
+
+    case LCDC_RENDER_ON_DEMAND:
+        // the display then shows this frame, or the end of it
+        // under the beginning of the next one
+        return cycle < lcd->display_cycle && cycle + 2 * FRAME_TOTAL_CYCLES > lcd->display_cycle;
+
+    default:
+        return true;
+    }
+}
+
+// ======================================================================
+/**
+ * @brief Runs the event of the controller planned for the given cycle
+ *        (start of a line or of mode 3 or 0), planning the next one
+ */
+static int lcdc_update(lcdc_t* lcd, uint64_t cycle)
+{
+    const uint64_t frame_cycle = (cycle - lcd->on_cycle) % FRAME_TOTAL_CYCLES;
+    if (frame_cycle == 0) {
+        lcd->render_frame = frame_rendered(lcd, cycle);
+        ++lcd->frame_count;
+        M_REQUIRE_NO_ERR(submit(lcd, render_command(RENDER_FRAME, 0, 0)));
+    }
+
+    const uint8_t y = (uint8_t)(frame_cycle / LINE_TOTAL_CYCLES);
+    const uint64_t line_cycle = frame_cycle % LINE_TOTAL_CYCLES;
+
+    if (y >= LCD_HEIGHT) {
+        M_REQUIRE(line_cycle == 0, ERR_BAD_PARAMETER, "V-blank event at cycle %" PRIu64 " of line", line_cycle);
+        if (y == LCD_HEIGHT) {
+            if (lcd->render_frame) {
+                M_REQUIRE_NO_ERR(submit(lcd, render_command(RENDER_FRAME_END, 0, 0)));
+            }
+            set_mode(lcd, 1);
+            cpu_request_interrupt(lcd->cpu, VBLANK);
+        }
+        LCD_MEM(lcd, REG_LY) = y;
+        update_lyc(lcd);
+        lcd->next_cycle += LINE_TOTAL_CYCLES;
+        return ERR_NONE;
+    }
+
+    switch (line_cycle) {
+    case LINE_MODE_2_START_CYCLE:
+        LCD_MEM(lcd, REG_LY) = y;
+        update_lyc(lcd);
+        set_mode(lcd, 2);
+        lcd->next_cycle += LINE_MODE_2_CYCLES;
+        break;
+
+    case LINE_MODE_3_START_CYCLE:
+        set_mode(lcd, 3);
+        // when the background is off (or the frame not rendered), the display
+        // keeps its previous line; the video memory written is sent later on
+        if (lcd->render_frame && LCD_REG_BIT(lcd, LCDC_REG_BG_MASK)) {
+            M_REQUIRE_NO_ERR(submit_line(lcd, y));
+        }
+        lcd->next_cycle += LINE_MODE_3_CYCLES;
+        break;
+
+    case LINE_MODE_0_START_CYCLE:
+        set_mode(lcd, 0);
+        lcd->next_cycle += LINE_MODE_0_CYCLES;
+        break;
+
+    default:
+        M_EXIT(ERR_BAD_PARAMETER, "no event at cycle %" PRIu64 " of line", line_cycle);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief Performs the OAM DMA transfer (of one byte per cycle) up to the
+ *        byte of the given cycle, copying the missing bytes in one block
+ */
+static int dma_copy(lcdc_t* lcd, uint64_t cycle)
+{
+    const uint64_t copied = cycle + DMA_SIZE - lcd->DMA_end_cycle;
+    const addr_t to = (addr_t)(DMA_START + (copied < DMA_SIZE ? copied : DMA_SIZE));
+    if (to > lcd->DMA_to) {
+        // the OAM is a single component: its bytes are contiguous
+        const size_t size = (size_t)(to - lcd->DMA_to);
+        M_REQUIRE_NO_ERR(bus_read_block(*lcd->cpu->bus, lcd->DMA_from, (*lcd->cpu->bus)[lcd->DMA_to], size));
+        M_REQUIRE_NO_ERR(lcdc_invalidate_range(lcd, lcd->DMA_to, size));
+        lcd->DMA_from = (addr_t)(lcd->DMA_from + size);
+        lcd->DMA_to = to;
+    }
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_init(gameboy_t* gb)
+{
+    M_REQUIRE_NON_NULL(gb);
+
+    lcdc_t* const lcd = &gb->screen;
+    lcd->cpu = &gb->cpu;
+    lcd->on = LCD_REG_BIT(lcd, LCDC_REG_LCD_STATUS_MASK) != 0;
+    lcd->next_cycle = (uint64_t) -1;
+    lcd->on_cycle = lcd->on ? 0 : (uint64_t) -1;
+    // no DMA transfer in progress
+    lcd->DMA_from = 0;
+    lcd->DMA_to = DMA_END + 1;
+    lcd->DMA_end_cycle = 0;
+    M_REQUIRE_NO_ERR(image_create(&lcd->display, LCD_WIDTH, LCD_HEIGHT));
+
+    lcdc_renderer_t* const r = &lcd->renderer;
+    memset(r->regs, 0, sizeof(r->regs));
+    memset(lcd->sent_regs, 0, sizeof(lcd->sent_regs));
+    r->window_y = 0;
+    // nothing decoded nor indexed yet
+    memset(r->tile_rows_dirty, 0xFF, sizeof(r->tile_rows_dirty));
+    r->sprite_index_height = 0;
+    r->display = &lcd->display;
+    r->frame_hash = &lcd->frame_hash;
+    lcd->frame_hash = framebuffer_hash(image_framebuffer(&lcd->display));
+    lcd->render_policy = LCDC_RENDER_ALWAYS;
+    lcd->render_period = 1;
+    lcd->display_cycle = 0;
+    lcd->frame_count = 0;
+    lcd->render_frame = true;
+    // the whole video memory is sent with the first line
+    memset(lcd->written, 0, sizeof(lcd->written));
+    M_REQUIRE_NO_ERR(lcdc_invalidate_range(lcd, VIDEO_RAM_START, MEM_SIZE(VIDEO_RAM)));
+    M_REQUIRE_NO_ERR(lcdc_invalidate_range(lcd, OAM_START, MEM_SIZE(OAM)));
+
+#ifdef LCDC_THREAD
+    lcd->render_error = ERR_NONE;
+    M_REQUIRE(sem_init(&lcd->submitted, 0, 0) == 0 && sem_init(&lcd->synced, 0, 0) == 0,
+              ERR_MEM, "%s", "cannot create the semaphores of the render thread");
+    M_REQUIRE_NO_ERR(spsc_queue_init(&lcd->queue, LCDC_QUEUE_SIZE));
+    if (pthread_create(&lcd->thread, NULL, render_thread, lcd) != 0) {
+        spsc_queue_free(&lcd->queue);
+        M_EXIT(ERR_MEM, "%s", "cannot start the render thread");
+    }
+#endif
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+void lcdc_free(lcdc_t* lcd)
+{
+    if (lcd != NULL) {
+#ifdef LCDC_THREAD
+        // the queue only exists along with the thread
+        if (lcd->queue.entries != NULL) {
+            submit(lcd, render_command(RENDER_STOP, 0, 0));
+            pthread_join(lcd->thread, NULL);
+            spsc_queue_free(&lcd->queue);
+            sem_destroy(&lcd->submitted);
+            sem_destroy(&lcd->synced);
+        }
+#endif
+        image_free(&lcd->display);
+    }
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_plug(lcdc_t* lcd, bus_t bus)
+{
+    M_REQUIRE_NON_NULL(lcd);
+    // the registers and video memory are components of the Game Boy:
+    // the controller reads them through the bus of its CPU
+    (void) bus;
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_cycle(lcdc_t* lcd, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(lcd);
+    M_REQUIRE(cycle <= lcd->next_cycle, ERR_BAD_PARAMETER,
+              "cycle %" PRIu64 " is past the next event (%" PRIu64 ")", cycle, lcd->next_cycle);
+
+    if (lcd->DMA_to <= DMA_END) {
+        if (lcd->DMA_end_cycle == (uint64_t) -1) {
+            // the transfer starts: one byte per cycle, from this one
+            lcd->DMA_end_cycle = cycle + DMA_SIZE - 1;
+        }
+        // the OAM only has to be up to date at the end of the transfer
+        // and when the controller may read it
+        if (cycle == lcd->DMA_end_cycle || cycle == lcd->next_cycle || lcd->next_cycle == (uint64_t) -1) {
+            M_REQUIRE_NO_ERR(dma_copy(lcd, cycle));
+        }
+    }
+
+    if (cycle == lcd->next_cycle) {
+        M_REQUIRE_NO_ERR(lcdc_update(lcd, cycle));
+    } else if (lcd->next_cycle == (uint64_t) -1 && LCD_REG_BIT(lcd, LCDC_REG_LCD_STATUS_MASK)) {
+        // the screen was just switched on
+        lcd->next_cycle = cycle;
+        lcd->on_cycle = cycle;
+        M_REQUIRE_NO_ERR(lcdc_update(lcd, cycle));
+    }
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_set_render_policy(lcdc_t* lcd, lcdc_render_policy_t policy, uint64_t period)
+{
+    M_REQUIRE_NON_NULL(lcd);
+    M_REQUIRE(policy == LCDC_RENDER_ALWAYS || policy == LCDC_RENDER_EVERY_NTH || policy == LCDC_RENDER_ON_DEMAND,
+              ERR_BAD_PARAMETER, "unknown render policy %d", policy);
+    M_REQUIRE(policy != LCDC_RENDER_EVERY_NTH || period > 0, ERR_BAD_PARAMETER, "%s", "render period of 0");
+
+    lcd->render_policy = policy;
+    lcd->render_period = policy == LCDC_RENDER_EVERY_NTH ? period : 1;
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_request_display(lcdc_t* lcd, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(lcd);
+
+    lcd->display_cycle = cycle;
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_sync(lcdc_t* lcd)
+{
+    M_REQUIRE_NON_NULL(lcd);
+
+#ifdef LCDC_THREAD
+    M_REQUIRE_NO_ERR(submit(lcd, render_command(RENDER_SYNC, 0, 0)));
+    while (sem_wait(&lcd->synced) != 0 && errno == EINTR) {}
+    // the render thread is waiting for the next commands
+    const int err = lcd->render_error;
+    lcd->render_error = ERR_NONE;
+    return err;
+#else
+    return ERR_NONE;
+#endif
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_invalidate_range(lcdc_t* lcd, addr_t start, size_t size)
+{
+    M_REQUIRE_NON_NULL(lcd);
+    M_REQUIRE(size <= BUS_SIZE, ERR_BAD_PARAMETER, "Range of %zu bytes larger than the bus", size);
+
+    for (size_t i = 0; i < size; ++i) {
+        mark_written(lcd, (addr_t)(start + i));
+    }
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_bus_listener(lcdc_t* lcd, addr_t addr)
+{
+    M_REQUIRE_NON_NULL(lcd);
+
+    switch (addr) {
+    case REG_LCDC: {
+        const bit_t on = LCD_REG_BIT(lcd, LCDC_REG_LCD_STATUS_MASK) != 0;
+        if (lcd->on && !on) {
+            set_mode(lcd, 0);
+            LCD_MEM(lcd, REG_LY) = 0;
+            update_lyc(lcd);
+            lcd->next_cycle = (uint64_t) -1;
+        }
+        lcd->on = on;
+    } break;
+
+    case REG_LYC:
+        update_lyc(lcd);
+        break;
+
+    case REG_DMA:
+        lcd->DMA_from = (addr_t)(LCD_MEM(lcd, REG_DMA) << 8);
+        lcd->DMA_to = DMA_START;
+        // scheduled on the next cycle
+        lcd->DMA_end_cycle = (uint64_t) -1;
+        break;
+
+    default:
+        // only the address of a 16-bit write is known: its second byte
+        // may be the first of the next tile row
+        mark_written(lcd, addr);
+        mark_written(lcd, (addr_t)(addr + 1));
+        break;
+    }
+    return ERR_NONE;
+}
@@ -14,6 +14,12 @@
 #include "bit.h"
 #include "image.h"
 #include "gameboy.h"
+#include "spsc_queue.h"
+
+#ifdef LCDC_THREAD
+#include <pthread.h>
+#include <semaphore.h>
+#endif
 
 typedef struct gameboy_ gameboy_t;
 
@@ -87,6 +93,11 @@ extern "C" {
 
 #define TILE_SIZE 16      // tile size (in bytes)
 
+// tile data: 384 tiles of 8 rows (2 bytes each), from TILE_SRC_ADDR_LOW
+#define TILE_DATA_END   0x97FF
+#define TILE_COUNT      384
+#define TILE_ROW_COUNT  (TILE_COUNT * 8)
+
 #define TILE_LINE_SIZE    32
 #define VISIBLE_LINE_SIZE 20
 
@@ -95,6 +106,74 @@ extern "C" {
 
 #define WINDOW_OFFSET_X  7
 
+
+// Sprites
+
+#define SPRITES_PER_LINE_MAX 10
+
+
+// Video memory and registers, as copied by the renderer
+
+#define LCD_VRAM_SIZE   0x2000 // from 0x8000
+#define LCD_OAM_SIZE    0xA0   // from 0xFE00
+#define LCD_MIRROR_SIZE (LCD_VRAM_SIZE + LCD_OAM_SIZE)
+#define LCD_REGS_COUNT  (REG_WX - REG_LCDC + 1)
+
+// Number of commands the render thread can lag behind (see LCDC_THREAD)
+#ifndef LCDC_QUEUE_SIZE
+#define LCDC_QUEUE_SIZE (1 << 16)
+#endif
+
+// Number of lines the render thread is woken up for
+#ifndef LCDC_BATCH_LINES
+#define LCDC_BATCH_LINES 16
+#endif
+
+// ======================================================================
+/**
+ * @brief A decoded tile row: the colors and opacity of its 8 pixels,
+ *        from the left
+ */
+typedef struct {
+    uint8_t pixels[8];
+    uint8_t opacity[8];
+} tile_row_t;
+
+// ======================================================================
+/**
+ * @brief Line renderer: renders the lines of the display from its own copy
+ *        of the video memory and registers, as they were when each line was
+ *        submitted to it (on the emulation thread, or on its own thread
+ *        with LCDC_THREAD)
+ */
+typedef struct {
+    data_t video_ram[LCD_VRAM_SIZE];
+    data_t oam[LCD_OAM_SIZE];
+    data_t regs[LCD_REGS_COUNT]; // from REG_LCDC
+    data_t window_y;
+    // decoded tile rows, redecoded when their bytes are written
+    tile_row_t tile_rows[TILE_ROW_COUNT];
+    uint64_t   tile_rows_dirty[TILE_ROW_COUNT / 64];
+    // sprites of each line in priority order, for sprites of the given
+    // height (0 when the OAM was written since)
+    uint8_t line_sprites[LCD_HEIGHT][SPRITES_PER_LINE_MAX];
+    uint8_t line_sprite_count[LCD_HEIGHT];
+    uint8_t sprite_index_height;
+    image_t*  display;
+    uint64_t* frame_hash;
+} lcdc_renderer_t;
+
+// ======================================================================
+/**
+ * @brief Which frames are rendered on the display (their timing, registers
+ *        and interrupts are the same in any case)
+ */
+typedef enum {
+    LCDC_RENDER_ALWAYS,    // every frame
+    LCDC_RENDER_EVERY_NTH, // one frame out of render_period
+    LCDC_RENDER_ON_DEMAND  // only the frames shown at the requested cycle
+} lcdc_render_policy_t;
+
 // ======================================================================
 /**
  * @brief lcdc type
@@ -106,8 +185,31 @@ typedef struct {
     uint64_t on_cycle;
     addr_t   DMA_from;
     addr_t   DMA_to;
+    uint64_t DMA_end_cycle;
     image_t  display;
-    data_t   window_y;
+    // hash of the display, at the end of the last frame rendered
+    uint64_t frame_hash;
+    lcdc_renderer_t renderer;
+    // bytes of video memory (then OAM) written since the last line was
+    // submitted, and the registers as last sent to the renderer
+    uint64_t written[(LCD_MIRROR_SIZE + 63) / 64];
+    bool     any_written;
+    data_t   sent_regs[LCD_REGS_COUNT];
+    // frames to render, and whether the current one is
+    lcdc_render_policy_t render_policy;
+    uint64_t render_period;
+    uint64_t display_cycle;
+    uint64_t frame_count;
+    bool     render_frame;
+#ifdef LCDC_THREAD
+    // commands to the render thread, which waits on submitted
+    // (posted for each line, sync or stop command)
+    spsc_queue_t queue;
+    pthread_t thread;
+    sem_t submitted;
+    sem_t synced;
+    int render_error;
+#endif
 } lcdc_t;
 
 
@@ -146,6 +248,57 @@ int lcdc_plug(lcdc_t* lcd, bus_t bus);
 int lcdc_cycle(lcdc_t* lcd, uint64_t cycle);
 
 
+/**
+ * @brief Sets which frames are rendered, from the next one on
+ *
+ * @param lcd LCD controler
+ * @param policy frames to render
+ * @param period for LCDC_RENDER_EVERY_NTH, one frame out of how many
+ * @return error code
+ */
+int lcdc_set_render_policy(lcdc_t* lcd, lcdc_render_policy_t policy, uint64_t period);
+
+
+/**
+ * @brief Requests the display to be up to date at the given cycle:
+ *        with LCDC_RENDER_ON_DEMAND, renders the (at most two) frames
+ *        shown on it then. To be requested before running up to the
+ *        previous frame, e.g. before each run when the display is read
+ *        after each run.
+ *
+ * @param lcd LCD controler
+ * @param cycle cycle at which the display is read
+ * @return error code
+ */
+int lcdc_request_display(lcdc_t* lcd, uint64_t cycle);
+
+
+/**
+ * @brief Waits for the lines submitted so far to be on the display
+ *        (immediate unless the lines are rendered on a thread)
+ *
+ * @param lcd LCD controler
+ * @return error code of the rendering of these lines
+ */
+int lcdc_sync(lcdc_t* lcd);
+
+
+/**
+ * @brief Marks bytes as written other than by the CPU (whose writes are
+ *        seen by lcdc_bus_listener()): the renderer works on its own copy
+ *        of the video memory and OAM, updated from the bytes marked.
+ *        To be called after writing the bus directly, e.g. with
+ *        bus_write_block() (see gameboy_write_block()).
+ *
+ * @param lcd LCD controler
+ * @param start address of the first byte written
+ * @param size number of bytes written (the addresses wrapping around;
+ *        only those of the video memory and OAM matter)
+ * @return error code
+ */
+int lcdc_invalidate_range(lcdc_t* lcd, addr_t start, size_t size);
+
+
 /**
  * @brief LCD controler bus listening handler
  *
@@ -17,7 +17,7 @@ static void set_grey(guchar* pixels, int row, int col, int width, guchar grey)
 }
 
 // ======================================================================
-static void generate_image(guchar* pixels, int height, int width)
+static gboolean generate_image(guchar* pixels, int height, int width)
 {
     static int N = 0;
     if (++N % 2) {
@@ -41,6 +41,7 @@ static void generate_image(guchar* pixels, int height, int width)
                 }
         }
     }
+    return TRUE;
 }
 
 // ======================================================================
@@ -0,0 +1,212 @@
+/**
+ * @file profiler.c
+ * @brief Sampling profiler of the emulated program
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "profiler.h"
+#include "cpu-storage.h"
+#include "opcode.h"
+#include "error.h"
+
+#define SYM_LINE_SIZE 256
+
+int profiler_init(profiler_t* prof, const char* filename, uint64_t period)
+{
+    M_REQUIRE_NON_NULL(prof);
+    M_REQUIRE_NON_NULL(filename);
+    M_REQUIRE(period > 0, ERR_BAD_PARAMETER, "%s", "Sampling period cannot be zero");
+
+    *prof = (profiler_t) { 0 };
+    prof->output = fopen(filename, "w");
+    if (NULL == prof->output)
+    {
+        return ERR_IO;
+    }
+    prof->period = period;
+    prof->next_sample = period;
+    return ERR_NONE;
+}
+
+static int symbol_cmp(const void* a, const void* b)
+{
+    const profiler_symbol_t* s1 = a;
+    const profiler_symbol_t* s2 = b;
+    return (int)s1->addr - (int)s2->addr;
+}
+
+int profiler_load_symbols(profiler_t* prof, const char* filename)
+{
+    M_REQUIRE_NON_NULL(prof);
+    M_REQUIRE_NON_NULL(filename);
+
+    FILE* file = fopen(filename, "r");
+    if (NULL == file)
+    {
+        return ERR_IO;
+    }
+
+    size_t capacity = prof->nb_symbols;
+    char line[SYM_LINE_SIZE];
+    while (NULL != fgets(line, SYM_LINE_SIZE, file))
+    {
+        unsigned int bank = 0, addr = 0;
+        profiler_symbol_t symbol = { 0 };
+        // comments start with ';', everything else is "BB:AAAA Label"
+        if (3 != sscanf(line, " %x:%x %63s", &bank, &addr, symbol.name) || addr > UINT16_MAX)
+        {
+            continue;
+        }
+        symbol.addr = (addr_t)addr;
+
+        if (prof->nb_symbols == capacity)
+        {
+            capacity = (capacity == 0) ? 64 : 2 * capacity;
+            profiler_symbol_t* symbols = realloc(prof->symbols, capacity * sizeof(profiler_symbol_t));
+            if (NULL == symbols)
+            {
+                fclose(file);
+                return ERR_MEM;
+            }
+            prof->symbols = symbols;
+        }
+        prof->symbols[prof->nb_symbols++] = symbol;
+    }
+    fclose(file);
+
+    qsort(prof->symbols, prof->nb_symbols, sizeof(profiler_symbol_t), symbol_cmp);
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief Finds the last symbol at or before a given address (NULL if none)
+ */
+static const profiler_symbol_t* profiler_find_symbol(const profiler_t* prof, addr_t addr)
+{
+    size_t low = 0;
+    size_t high = prof->nb_symbols;
+    // invariant: symbols[0..low) are <= addr, symbols[high..) are > addr
+    while (low < high)
+    {
+        const size_t mid = low + (high - low) / 2;
+        if (prof->symbols[mid].addr <= addr)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return (low == 0) ? NULL : &prof->symbols[low - 1];
+}
+
+static void profiler_print_addr(const profiler_t* prof, addr_t addr)
+{
+    const profiler_symbol_t* symbol = profiler_find_symbol(prof, addr);
+    if (NULL == symbol)
+    {
+        fprintf(prof->output, "0x%04" PRIX16, addr);
+    }
+    else if (symbol->addr == addr)
+    {
+        fputs(symbol->name, prof->output);
+    }
+    else
+    {
+        fprintf(prof->output, "%s+0x%" PRIX16, symbol->name, (addr_t)(addr - symbol->addr));
+    }
+}
+
+static void profiler_sample(const profiler_t* prof, addr_t PC)
+{
+    fputs("root", prof->output);
+    for (size_t i = 0; i < prof->depth; ++i)
+    {
+        fputc(';', prof->output);
+        profiler_print_addr(prof, prof->stack[i].entry);
+    }
+    fputc(';', prof->output);
+    profiler_print_addr(prof, PC);
+    fputs(" 1\n", prof->output);
+}
+
+// ======================================================================
+/**
+ * @brief Tells whether a 2 bytes push on the stack entered a new routine:
+ *        CALL and RST always do, anything else that did not simply move on
+ *        to the next instruction (i.e. not a PUSH) is an interrupt
+ */
+static bool profiler_entered_routine(const cpu_t* cpu, addr_t last_PC)
+{
+    const instruction_t* lu = &instruction_direct[cpu_read_at_idx(cpu, last_PC)];
+    switch (lu->family)
+    {
+    case CALL_N16:
+    case CALL_CC_N16:
+    case RST_U3:
+        return true;
+
+    default:
+        return cpu->PC != (addr_t)(last_PC + lu->bytes);
+    }
+}
+
+int profiler_cycle(profiler_t* prof, const cpu_t* cpu, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(prof);
+    M_REQUIRE_NON_NULL(cpu);
+    M_REQUIRE_NON_NULL(prof->output);
+
+    if (cpu->SP < prof->last_SP)
+    {
+        if (prof->last_SP - cpu->SP == SP_UNITS && profiler_entered_routine(cpu, prof->last_PC))
+        {
+            /* frames deeper than the shadow stack are dropped: their SP being below
+             * all the recorded ones, returning from them never unwinds the stack */
+            if (prof->depth < PROFILER_STACK_SIZE)
+            {
+                prof->stack[prof->depth++] = (profiler_frame_t) { .entry = cpu->PC, .SP = cpu->SP };
+            }
+        }
+    }
+    else if (cpu->SP > prof->last_SP)
+    {
+        /* RET, RETI, but also any other way of dropping a return address
+         * (e.g. POP then JP) leaves the routines whose frame is now above SP */
+        while (prof->depth > 0 && prof->stack[prof->depth - 1].SP < cpu->SP)
+        {
+            --prof->depth;
+        }
+    }
+    prof->last_PC = cpu->PC;
+    prof->last_SP = cpu->SP;
+
+    if (cycle >= prof->next_sample)
+    {
+        profiler_sample(prof, cpu->PC);
+        prof->next_sample = cycle + prof->period;
+    }
+
+    return ERR_NONE;
+}
+
+void profiler_free(profiler_t* prof)
+{
+    if (NULL != prof)
+    {
+        if (NULL != prof->output)
+        {
+            fclose(prof->output);
+        }
+        free(prof->symbols);
+        *prof = (profiler_t) { 0 };
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+/**
+ * @file profiler.h
+ * @brief Sampling profiler of the emulated program, producing collapsed stacks
+ *        (one "frame;frame;frame count" line per sample, as read by flamegraph.pl)
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "memory.h"
+#include "cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum depth of the shadow call stack (deeper frames are not recorded)
+#define PROFILER_STACK_SIZE 64
+
+// Maximum length of a symbol name (including the final '\0')
+#define PROFILER_SYMBOL_SIZE 64
+
+// Default sampling period (in Game Boy cycles) and output file
+#ifndef PROFILER_PERIOD
+#define PROFILER_PERIOD 1024
+#endif
+#ifndef PROFILER_OUTPUT
+#define PROFILER_OUTPUT "profile.folded"
+#endif
+
+/**
+ * @brief A symbol of the ROM, as found in a RGBDS .sym file
+ */
+typedef struct {
+    addr_t addr;
+    char name[PROFILER_SYMBOL_SIZE];
+} profiler_symbol_t;
+
+/**
+ * @brief A frame of the shadow call stack:
+ *        the entry address of the routine and the value of SP right after the call
+ */
+typedef struct {
+    addr_t entry;
+    addr_t SP;
+} profiler_frame_t;
+
+/**
+ * @brief Profiler type
+ */
+typedef struct {
+    FILE* output;
+    uint64_t period;
+    uint64_t next_sample;
+    profiler_frame_t stack[PROFILER_STACK_SIZE];
+    size_t depth;
+    addr_t last_PC;
+    addr_t last_SP;
+    profiler_symbol_t* symbols;
+    size_t nb_symbols;
+} profiler_t;
+
+
+/**
+ * @brief Initiates a profiler
+ *
+ * @param prof profiler to initiate
+ * @param filename file to write the collapsed stacks to
+ * @param period number of cycles between two samples
+ * @return error code
+ */
+int profiler_init(profiler_t* prof, const char* filename, uint64_t period);
+
+
+/**
+ * @brief Loads the symbols of a RGBDS .sym file ("BB:AAAA Label" lines)
+ *
+ * @param prof profiler to load the symbols into
+ * @param filename .sym file to read
+ * @return error code
+ */
+int profiler_load_symbols(profiler_t* prof, const char* filename);
+
+
+/**
+ * @brief Follows the CPU after one of its cycles: maintains the shadow call stack
+ *        (CALL, RST, interrupts and RET/RETI) and writes a sample every period
+ *
+ * @param prof profiler
+ * @param cpu CPU which just ran its cycle
+ * @param cycle the current cycle number
+ * @return error code
+ */
+int profiler_cycle(profiler_t* prof, const cpu_t* cpu, uint64_t cycle);
+
+
+/**
+ * @brief Frees a profiler (and closes its output)
+ *
+ * @param prof profiler to free
+ */
+void profiler_free(profiler_t* prof);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,445 @@
+/**
+ * @file scale.c
+ * @brief Integer upscaling of packed pixels
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "scale.h"
+#include "error.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCALE_SIMD
+#include <immintrin.h>
+#endif
+
+// ======================================================================
+/*
+ * Kernels expanding a row horizontally (from pixel first on) and filtering
+ * a row, in scalar and SSSE3 versions, the best ones supported by the CPU
+ * being selected once at load time (as in framebuffer.c).
+ */
+typedef void (*expand_t)(uint8_t* dst, const uint8_t* src, size_t width, size_t bytes_per_pixel,
+                         size_t factor, size_t first);
+
+/*
+ * A filter row kernel writes the filter factor output rows of a row,
+ * given its neighbours above and below (the row itself on the borders).
+ */
+typedef void (*filter_row_t)(uint8_t* const out[SCALE_SCALE3X], const uint8_t* above, const uint8_t* row,
+                             const uint8_t* below, size_t width);
+
+static void expand_scalar(uint8_t* dst, const uint8_t* src, size_t width, size_t bytes_per_pixel,
+                          size_t factor, size_t first)
+{
+    uint8_t* out = dst + first * factor * bytes_per_pixel;
+    for (size_t x = first; x < width; ++x)
+    {
+        for (size_t f = 0; f < factor; ++f, out += bytes_per_pixel)
+        {
+            memcpy(out, src + x * bytes_per_pixel, bytes_per_pixel);
+        }
+    }
+}
+
+/*
+ * The neighbours of pixel E, in the names of the AdvanceMAME description
+ * of Scale2x and Scale3x:
+ *     A B C
+ *     D E F
+ *     G H I
+ * A corner of E takes the color of its two sides when they are equal
+ * and the opposite sides differ.
+ */
+#define SCALE_NEIGHBOURS(above, row, below, x, width) \
+    const size_t left = (x) > 0 ? (x) - 1 : (x); \
+    const size_t right = (x) + 1 < (width) ? (x) + 1 : (x); \
+    const uint8_t A = (above)[left], B = (above)[x], C = (above)[right]; \
+    const uint8_t D = (row)[left], E = (row)[x], F = (row)[right]; \
+    const uint8_t G = (below)[left], H = (below)[x], I = (below)[right]; \
+    const int top_left = D == B && B != F && D != H; \
+    const int top_right = B == F && B != D && F != H; \
+    const int bottom_left = D == H && D != B && H != F; \
+    const int bottom_right = H == F && D != H && B != F
+
+static void scale2x_scalar_range(uint8_t* const out[SCALE_SCALE3X], const uint8_t* above, const uint8_t* row,
+                                 const uint8_t* below, size_t width, size_t first, size_t last)
+{
+    for (size_t x = first; x < last; ++x)
+    {
+        SCALE_NEIGHBOURS(above, row, below, x, width);
+        (void) A; (void) C; (void) G; (void) I;
+        out[0][2 * x] = top_left ? D : E;
+        out[0][2 * x + 1] = top_right ? F : E;
+        out[1][2 * x] = bottom_left ? D : E;
+        out[1][2 * x + 1] = bottom_right ? F : E;
+    }
+}
+
+static void scale3x_scalar_range(uint8_t* const out[SCALE_SCALE3X], const uint8_t* above, const uint8_t* row,
+                                 const uint8_t* below, size_t width, size_t first, size_t last)
+{
+    for (size_t x = first; x < last; ++x)
+    {
+        SCALE_NEIGHBOURS(above, row, below, x, width);
+        out[0][3 * x] = top_left ? D : E;
+        out[0][3 * x + 1] = (top_left && E != C) || (top_right && E != A) ? B : E;
+        out[0][3 * x + 2] = top_right ? F : E;
+        out[1][3 * x] = (top_left && E != G) || (bottom_left && E != A) ? D : E;
+        out[1][3 * x + 1] = E;
+        out[1][3 * x + 2] = (top_right && E != I) || (bottom_right && E != C) ? F : E;
+        out[2][3 * x] = bottom_left ? D : E;
+        out[2][3 * x + 1] = (bottom_left && E != I) || (bottom_right && E != G) ? H : E;
+        out[2][3 * x + 2] = bottom_right ? F : E;
+    }
+}
+
+static void scale2x_scalar(uint8_t* const out[SCALE_SCALE3X], const uint8_t* above, const uint8_t* row,
+                           const uint8_t* below, size_t width)
+{
+    scale2x_scalar_range(out, above, row, below, width, 0, width);
+}
+
+static void scale3x_scalar(uint8_t* const out[SCALE_SCALE3X], const uint8_t* above, const uint8_t* row,
+                           const uint8_t* below, size_t width)
+{
+    scale3x_scalar_range(out, above, row, below, width, 0, width);
+}
+
+static struct {
+    expand_t expand;
+    filter_row_t scale2x;
+    filter_row_t scale3x;
+} kernels = { expand_scalar, scale2x_scalar, scale3x_scalar };
+
+#ifdef SCALE_SIMD
+// byte j of an expanded row is byte source_byte(j) of its input row
+#define source_byte(j, bpp, factor) ((j) / ((bpp) * (factor)) * (bpp) + (j) % (bpp))
+
+static size_t gcd(size_t a, size_t b)
+{
+    while (b != 0)
+    {
+        const size_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/*
+ * The expanded row is made of 16-byte chunks, each a shuffle of 16 bytes of
+ * the input. Their shuffles repeat with a period of lcm(16, bpp * factor)
+ * bytes, that is at most bpp * factor chunks, and the 16 bytes of a chunk
+ * come from at most 12 input bytes (16 when factor is 1).
+ */
+__attribute__((target("ssse3")))
+static void expand_ssse3(uint8_t* dst, const uint8_t* src, size_t width, size_t bytes_per_pixel,
+                         size_t factor, size_t first)
+{
+    const size_t group = bytes_per_pixel * factor;
+    const size_t period = 16 / gcd(16, group) * group;
+    const size_t chunks = period / 16;
+    const size_t input_period = period / factor;
+
+    __m128i controls[SCALE_MAX_FACTOR * SCALE_MAX_BYTES_PER_PIXEL];
+    size_t offsets[SCALE_MAX_FACTOR * SCALE_MAX_BYTES_PER_PIXEL];
+    for (size_t c = 0; c < chunks; ++c)
+    {
+        size_t base = source_byte(16 * c, bytes_per_pixel, factor);
+        for (size_t i = 1; i < 16; ++i)
+        {
+            const size_t byte = source_byte(16 * c + i, bytes_per_pixel, factor);
+            base = byte < base ? byte : base;
+        }
+        uint8_t control[16];
+        for (size_t i = 0; i < 16; ++i)
+        {
+            control[i] = (uint8_t) (source_byte(16 * c + i, bytes_per_pixel, factor) - base);
+        }
+        controls[c] = _mm_loadu_si128((const __m128i*) control);
+        offsets[c] = base;
+    }
+
+    // the chunks which read and write within the rows, from pixel first
+    const size_t input_size = width * bytes_per_pixel;
+    const size_t output_size = input_size * factor;
+    size_t j = first * group / 16;
+    size_t c = j % chunks;
+    size_t input_start = j / chunks * input_period;
+    for (; 16 * (j + 1) <= output_size && input_start + offsets[c] + 16 <= input_size; ++j)
+    {
+        const __m128i in = _mm_loadu_si128((const __m128i*) (src + input_start + offsets[c]));
+        _mm_storeu_si128((__m128i*) (dst + 16 * j), _mm_shuffle_epi8(in, controls[c]));
+        if (++c == chunks)
+        {
+            c = 0;
+            input_start += input_period;
+        }
+    }
+    // the end of the row, from the pixel of the first chunk not written
+    const size_t next = 16 * j / group;
+    expand_scalar(dst, src, width, bytes_per_pixel, factor, next > first ? next : first);
+}
+
+// shuffles interleaving 3 vectors a, b, c into a0 b0 c0 a1 b1 c1...: chunk k of the result
+// is the union of the shuffles of the 3 vectors by interleave3[k][vector]
+static uint8_t interleave3[3][3][16];
+
+/*
+ * The 16 pixels from x on, with their neighbours, and the conditions on
+ * their corners as in SCALE_NEIGHBOURS, as byte masks.
+ */
+#define SCALE_NEIGHBOURS_SSSE3(above, row, below, x) \
+    const __m128i A = _mm_loadu_si128((const __m128i*) ((above) + (x) - 1)); \
+    const __m128i B = _mm_loadu_si128((const __m128i*) ((above) + (x))); \
+    const __m128i C = _mm_loadu_si128((const __m128i*) ((above) + (x) + 1)); \
+    const __m128i D = _mm_loadu_si128((const __m128i*) ((row) + (x) - 1)); \
+    const __m128i E = _mm_loadu_si128((const __m128i*) ((row) + (x))); \
+    const __m128i F = _mm_loadu_si128((const __m128i*) ((row) + (x) + 1)); \
+    const __m128i G = _mm_loadu_si128((const __m128i*) ((below) + (x) - 1)); \
+    const __m128i H = _mm_loadu_si128((const __m128i*) ((below) + (x))); \
+    const __m128i I = _mm_loadu_si128((const __m128i*) ((below) + (x) + 1)); \
+    const __m128i DB = _mm_cmpeq_epi8(D, B); \
+    const __m128i BF = _mm_cmpeq_epi8(B, F); \
+    const __m128i DH = _mm_cmpeq_epi8(D, H); \
+    const __m128i HF = _mm_cmpeq_epi8(H, F); \
+    const __m128i top_left = _mm_andnot_si128(BF, _mm_andnot_si128(DH, DB)); \
+    const __m128i top_right = _mm_andnot_si128(DB, _mm_andnot_si128(HF, BF)); \
+    const __m128i bottom_left = _mm_andnot_si128(DB, _mm_andnot_si128(HF, DH)); \
+    const __m128i bottom_right = _mm_andnot_si128(DH, _mm_andnot_si128(BF, HF))
+
+// mask ? x : y
+#define select_ssse3(mask, x, y) _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y))
+
+// condition && E != other
+#define and_differ_ssse3(condition, other) _mm_andnot_si128(_mm_cmpeq_epi8(E, other), condition)
+
+// the first pixel and the last 16 at most in scalar: their neighbours are clamped
+__attribute__((target("ssse3")))
+static void scale2x_ssse3(uint8_t* const out[SCALE_SCALE3X], const uint8_t* above, const uint8_t* row,
+                          const uint8_t* below, size_t width)
+{
+    scale2x_scalar_range(out, above, row, below, width, 0, 1);
+    size_t x = 1;
+    for (; x + 17 <= width; x += 16)
+    {
+        SCALE_NEIGHBOURS_SSSE3(above, row, below, x);
+        (void) A; (void) C; (void) G; (void) I;
+        const __m128i e0 = select_ssse3(top_left, D, E);
+        const __m128i e1 = select_ssse3(top_right, F, E);
+        const __m128i e2 = select_ssse3(bottom_left, D, E);
+        const __m128i e3 = select_ssse3(bottom_right, F, E);
+        _mm_storeu_si128((__m128i*) (out[0] + 2 * x), _mm_unpacklo_epi8(e0, e1));
+        _mm_storeu_si128((__m128i*) (out[0] + 2 * x + 16), _mm_unpackhi_epi8(e0, e1));
+        _mm_storeu_si128((__m128i*) (out[1] + 2 * x), _mm_unpacklo_epi8(e2, e3));
+        _mm_storeu_si128((__m128i*) (out[1] + 2 * x + 16), _mm_unpackhi_epi8(e2, e3));
+    }
+    scale2x_scalar_range(out, above, row, below, width, x, width);
+}
+
+__attribute__((target("ssse3")))
+static void store_interleaved3(uint8_t* dst, __m128i a, __m128i b, __m128i c)
+{
+    for (size_t k = 0; k < 3; ++k)
+    {
+        const __m128i from_a = _mm_shuffle_epi8(a, _mm_loadu_si128((const __m128i*) interleave3[k][0]));
+        const __m128i from_b = _mm_shuffle_epi8(b, _mm_loadu_si128((const __m128i*) interleave3[k][1]));
+        const __m128i from_c = _mm_shuffle_epi8(c, _mm_loadu_si128((const __m128i*) interleave3[k][2]));
+        _mm_storeu_si128((__m128i*) (dst + 16 * k), _mm_or_si128(from_a, _mm_or_si128(from_b, from_c)));
+    }
+}
+
+__attribute__((target("ssse3")))
+static void scale3x_ssse3(uint8_t* const out[SCALE_SCALE3X], const uint8_t* above, const uint8_t* row,
+                          const uint8_t* below, size_t width)
+{
+    scale3x_scalar_range(out, above, row, below, width, 0, 1);
+    size_t x = 1;
+    for (; x + 17 <= width; x += 16)
+    {
+        SCALE_NEIGHBOURS_SSSE3(above, row, below, x);
+        const __m128i e1 = _mm_or_si128(and_differ_ssse3(top_left, C), and_differ_ssse3(top_right, A));
+        const __m128i e3 = _mm_or_si128(and_differ_ssse3(top_left, G), and_differ_ssse3(bottom_left, A));
+        const __m128i e5 = _mm_or_si128(and_differ_ssse3(top_right, I), and_differ_ssse3(bottom_right, C));
+        const __m128i e7 = _mm_or_si128(and_differ_ssse3(bottom_left, I), and_differ_ssse3(bottom_right, G));
+        store_interleaved3(out[0] + 3 * x, select_ssse3(top_left, D, E), select_ssse3(e1, B, E),
+                           select_ssse3(top_right, F, E));
+        store_interleaved3(out[1] + 3 * x, select_ssse3(e3, D, E), E, select_ssse3(e5, F, E));
+        store_interleaved3(out[2] + 3 * x, select_ssse3(bottom_left, D, E), select_ssse3(e7, H, E),
+                           select_ssse3(bottom_right, F, E));
+    }
+    scale3x_scalar_range(out, above, row, below, width, x, width);
+}
+
+__attribute__((constructor))
+static void select_kernels(void)
+{
+    for (size_t k = 0; k < 3; ++k)
+    {
+        for (size_t i = 0; i < 16; ++i)
+        {
+            const size_t byte = 16 * k + i;
+            for (size_t v = 0; v < 3; ++v)
+            {
+                // the high bit set gives a zero byte
+                interleave3[k][v][i] = byte % 3 == v ? (uint8_t) (byte / 3) : 0x80;
+            }
+        }
+    }
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        kernels.expand = expand_ssse3;
+        kernels.scale2x = scale2x_ssse3;
+        kernels.scale3x = scale3x_ssse3;
+    }
+}
+#endif
+
+// ======================================================================
+int scale_nearest(const pixmap_t* output, const pixmap_t* input, size_t factor)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(output->pixels);
+    M_REQUIRE_NON_NULL(input);
+    M_REQUIRE_NON_NULL(input->pixels);
+    M_REQUIRE(factor >= 1 && factor <= SCALE_MAX_FACTOR, ERR_BAD_PARAMETER,
+              "scale factor %zu not in [1, %d]", factor, SCALE_MAX_FACTOR);
+    M_REQUIRE(input->bytes_per_pixel >= 1 && input->bytes_per_pixel <= SCALE_MAX_BYTES_PER_PIXEL
+              && output->bytes_per_pixel == input->bytes_per_pixel, ERR_BAD_PARAMETER,
+              "%zu and %zu bytes per pixel", input->bytes_per_pixel, output->bytes_per_pixel);
+    M_REQUIRE(output->width == input->width * factor && output->height == input->height * factor,
+              ERR_BAD_PARAMETER, "output of %zux%zu pixels for an input of %zux%zu scaled by %zu",
+              output->width, output->height, input->width, input->height, factor);
+    const size_t row_size = output->width * output->bytes_per_pixel;
+    M_REQUIRE(input->stride >= input->width * input->bytes_per_pixel && output->stride >= row_size,
+              ERR_BAD_PARAMETER, "strides of %zu and %zu bytes too short", input->stride, output->stride);
+
+    for (size_t y = 0; y < input->height; ++y)
+    {
+        uint8_t* const row = output->pixels + y * factor * output->stride;
+        kernels.expand(row, input->pixels + y * input->stride, input->width, input->bytes_per_pixel, factor, 0);
+        for (size_t f = 1; f < factor; ++f)
+        {
+            memcpy(row + f * output->stride, row, row_size);
+        }
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief A band of input rows to filter, [first, last)
+ */
+typedef struct {
+    const pixmap_t* output;
+    const pixmap_t* input;
+    scale_filter_t filter;
+    size_t first;
+    size_t last;
+} scale_band_t;
+
+static void* filter_band(void* arg)
+{
+    const scale_band_t* const band = arg;
+    const pixmap_t* const input = band->input;
+    const pixmap_t* const output = band->output;
+    const size_t factor = (size_t) band->filter;
+    for (size_t y = band->first; y < band->last; ++y)
+    {
+        const uint8_t* const row = input->pixels + y * input->stride;
+        // only the factor output rows of the row
+        uint8_t* out[SCALE_SCALE3X] = { NULL };
+        for (size_t r = 0; r < factor; ++r)
+        {
+            out[r] = output->pixels + (factor * y + r) * output->stride;
+        }
+        if (band->filter == SCALE_NONE)
+        {
+            memcpy(out[0], row, input->width);
+            continue;
+        }
+
+        // the rows outside are the border ones repeated
+        const uint8_t* const above = y > 0 ? row - input->stride : row;
+        const uint8_t* const below = y + 1 < input->height ? row + input->stride : row;
+        if (band->filter == SCALE_SCALE2X)
+        {
+            kernels.scale2x(out, above, row, below, input->width);
+        }
+        else
+        {
+            kernels.scale3x(out, above, row, below, input->width);
+        }
+    }
+    return NULL;
+}
+
+int scale_filter(const pixmap_t* output, const pixmap_t* input, scale_filter_t filter, size_t nb_threads)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(output->pixels);
+    M_REQUIRE_NON_NULL(input);
+    M_REQUIRE_NON_NULL(input->pixels);
+    M_REQUIRE(filter == SCALE_NONE || filter == SCALE_SCALE2X || filter == SCALE_SCALE3X,
+              ERR_BAD_PARAMETER, "unknown filter %d", filter);
+    M_REQUIRE(nb_threads >= 1 && nb_threads <= SCALE_MAX_THREADS, ERR_BAD_PARAMETER,
+              "%zu threads not in [1, %d]", nb_threads, SCALE_MAX_THREADS);
+    M_REQUIRE(input->bytes_per_pixel == 1 && output->bytes_per_pixel == 1, ERR_BAD_PARAMETER,
+              "%zu and %zu bytes per pixel, instead of 1", input->bytes_per_pixel, output->bytes_per_pixel);
+    const size_t factor = (size_t) filter;
+    M_REQUIRE(output->width == input->width * factor && output->height == input->height * factor,
+              ERR_BAD_PARAMETER, "output of %zux%zu pixels for an input of %zux%zu filtered by %zu",
+              output->width, output->height, input->width, input->height, factor);
+    M_REQUIRE(input->stride >= input->width && output->stride >= output->width,
+              ERR_BAD_PARAMETER, "strides of %zu and %zu bytes too short", input->stride, output->stride);
+
+    // bands of (about) equal heights, the first one filtered by this thread;
+    // a thread per band only pays off for bands of SCALE_MIN_BAND_PIXELS
+    const size_t max_bands = output->width * output->height / SCALE_MIN_BAND_PIXELS;
+    if (nb_threads > max_bands)
+    {
+        nb_threads = max_bands > 0 ? max_bands : 1;
+    }
+    if (nb_threads > input->height)
+    {
+        nb_threads = input->height > 0 ? input->height : 1;
+    }
+    scale_band_t bands[SCALE_MAX_THREADS];
+    pthread_t threads[SCALE_MAX_THREADS];
+    int started[SCALE_MAX_THREADS] = { 0 };
+    for (size_t t = 0; t < nb_threads; ++t)
+    {
+        bands[t] = (scale_band_t) {
+            .output = output,
+            .input = input,
+            .filter = filter,
+            .first = t * input->height / nb_threads,
+            .last = (t + 1) * input->height / nb_threads
+        };
+    }
+    for (size_t t = 1; t < nb_threads; ++t)
+    {
+        started[t] = pthread_create(&threads[t], NULL, filter_band, &bands[t]) == 0;
+    }
+    filter_band(&bands[0]);
+    for (size_t t = 1; t < nb_threads; ++t)
+    {
+        if (started[t])
+        {
+            pthread_join(threads[t], NULL);
+        }
+        else
+        {
+            // no thread: filtered here
+            filter_band(&bands[t]);
+        }
+    }
+    return ERR_NONE;
+}
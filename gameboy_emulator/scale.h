@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+ * @file scale.h
+ * @brief Integer upscaling of packed pixels (e.g. the RGB output of
+ *        framebuffer_to_rgb()) for the display, by nearest neighbour,
+ *        and pixel-art filters on the colors of a frame
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest scale factor
+#define SCALE_MAX_FACTOR 16
+
+// Largest number of bytes per pixel
+#define SCALE_MAX_BYTES_PER_PIXEL 4
+
+// Largest number of threads of a filter
+#define SCALE_MAX_THREADS 16
+
+// Smallest band of output pixels filtered by a thread of its own (smaller
+// bands cost less to filter than to start a thread: a 160x144 frame takes
+// about 40 us with Scale3x)
+#define SCALE_MIN_BAND_PIXELS (1 << 20)
+
+/**
+ * @brief Pixel-art filters, of value their scale factor
+ */
+typedef enum {
+    SCALE_NONE = 1,
+    SCALE_SCALE2X = 2,
+    SCALE_SCALE3X = 3
+} scale_filter_t;
+
+/**
+ * @brief Type to represent packed pixels: height rows of width pixels
+ *        of bytes_per_pixel bytes each, the rows being stride bytes apart
+ */
+typedef struct {
+    uint8_t* pixels;
+    size_t width;
+    size_t height;
+    size_t stride;
+    size_t bytes_per_pixel;
+} pixmap_t;
+
+
+/**
+ * @brief Scales up by nearest neighbour: each input row is expanded once,
+ *        then copied to the factor output rows it covers
+ *
+ * @param output scaled pixels, of factor times the width and height of
+ *        input and of the same bytes per pixel
+ * @param input pixels to scale
+ * @param factor scale factor, from 1 to SCALE_MAX_FACTOR
+ * @return error code
+ */
+int scale_nearest(const pixmap_t* output, const pixmap_t* input, size_t factor);
+
+
+/**
+ * @brief Scales up by a pixel-art filter (Scale2x or Scale3x, as in AdvanceMAME),
+ *        which rounds the edges between pixels of equal colors. The pixels are
+ *        compared as a whole: the filter is meant for the colors of a frame
+ *        (one byte per pixel, e.g. a framebuffer), before their conversion.
+ *        The rows are split in bands, each filtered by a thread, if the
+ *        output has SCALE_MIN_BAND_PIXELS pixels per band (a frame at
+ *        native resolution is filtered by the calling thread).
+ *
+ * @param output filtered pixels, of filter times the width and height of input
+ * @param input pixels to filter, of one byte each
+ * @param filter filter to apply (SCALE_NONE copies the input)
+ * @param nb_threads largest number of threads to use, from 1 to SCALE_MAX_THREADS
+ * @return error code
+ */
+int scale_filter(const pixmap_t* output, const pixmap_t* input, scale_filter_t filter, size_t nb_threads);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,17 +7,22 @@
  */
 
 #include "sidlib.h"
+#include "timeline.h"
 
 // ======================================================================
 static int update_(gpointer data)
 {
     simple_image_displayer_t* const psd = data;
+    timeline_begin("update_", "frontend");
 
     GdkPixbuf* pb = gtk_image_get_pixbuf(GTK_IMAGE(psd->image));
     // gdk_pixbuf_fill(pb, 0); // clear to black
 
     guchar* pixels = gdk_pixbuf_get_pixels(pb);
-    psd->gen(pixels, psd->height, psd->width);
+    if (!psd->gen(pixels, psd->height, psd->width)) {
+        timeline_end("update_", "frontend");
+        return 1; // continue timer
+    }
     gtk_image_set_from_pixbuf(GTK_IMAGE(psd->image),
                               gdk_pixbuf_new_from_data(
                               pixels,
@@ -30,6 +35,7 @@ static int update_(gpointer data)
                               )
                              );
 
+    timeline_end("update_", "frontend");
     return 1; // continue timer
 }
 
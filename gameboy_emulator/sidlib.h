@@ -15,9 +15,10 @@ extern "C" {
 #endif
 
 /**
- * @brief image generator function type
+ * @brief image generator function type:
+ *        returns FALSE when the image did not change (it is then not redisplayed)
  */
-typedef void (*ds_image_generator)(guchar*, int, int);
+typedef gboolean (*ds_image_generator)(guchar*, int, int);
 
 
 /**
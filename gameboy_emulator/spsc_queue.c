@@ -0,0 +1,70 @@
+/**
+ * @file spsc_queue.c
+ * @brief Lock-free queue between one producer thread and one consumer thread
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include "spsc_queue.h"
+#include "error.h"
+
+#include <stdlib.h>
+
+// ==== see spsc_queue.h ========================================
+int spsc_queue_init(spsc_queue_t* queue, size_t capacity)
+{
+    M_REQUIRE_NON_NULL(queue);
+    M_REQUIRE(capacity > 0 && (capacity & (capacity - 1)) == 0, ERR_BAD_PARAMETER,
+              "capacity %zu is not a power of two", capacity);
+
+    queue->entries = calloc(capacity, sizeof(uint32_t));
+    M_EXIT_IF_NULL(queue->entries, capacity * sizeof(uint32_t));
+    queue->mask = capacity - 1;
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->head, 0);
+    queue->head_seen = 0;
+    queue->tail_seen = 0;
+    return ERR_NONE;
+}
+
+// ==== see spsc_queue.h ========================================
+void spsc_queue_free(spsc_queue_t* queue)
+{
+    if (queue != NULL) {
+        free(queue->entries);
+        queue->entries = NULL;
+    }
+}
+
+// ==== see spsc_queue.h ========================================
+bool spsc_queue_push(spsc_queue_t* queue, uint32_t entry)
+{
+    const size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail - queue->head_seen > queue->mask) {
+        // the consumer's progress is only fetched when the queue looks full
+        queue->head_seen = atomic_load_explicit(&queue->head, memory_order_acquire);
+        if (tail - queue->head_seen > queue->mask) {
+            return false;
+        }
+    }
+    queue->entries[tail & queue->mask] = entry;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// ==== see spsc_queue.h ========================================
+bool spsc_queue_pop(spsc_queue_t* queue, uint32_t* entry)
+{
+    const size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head == queue->tail_seen) {
+        // the producer's progress is only fetched when the queue looks empty
+        queue->tail_seen = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (head == queue->tail_seen) {
+            return false;
+        }
+    }
+    *entry = queue->entries[head & queue->mask];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+/**
+ * @file spsc_queue.h
+ * @brief Lock-free queue of 32-bit entries, between one producer thread
+ *        and one consumer thread
+ *
+ * The entries are kept in a ring whose size is a power of two. The producer
+ * only writes the tail and the consumer only writes the head, each publishing
+ * it (release) after having written (resp. read) the entries, so that neither
+ * side ever waits on the other: a full queue fails to push, an empty one to pop.
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of a cache line: the head and the tail are on their own lines
+#define SPSC_QUEUE_LINE_SIZE 64
+
+/**
+ * @brief Queue type
+ */
+typedef struct {
+    uint32_t* entries;
+    size_t mask; // number of entries - 1
+    // written by the producer only
+    _Alignas(SPSC_QUEUE_LINE_SIZE) _Atomic size_t tail;
+    size_t head_seen;
+    // written by the consumer only
+    _Alignas(SPSC_QUEUE_LINE_SIZE) _Atomic size_t head;
+    size_t tail_seen;
+} spsc_queue_t;
+
+
+/**
+ * @brief Initiates an empty queue
+ *
+ * @param queue queue to initiate
+ * @param capacity number of entries it can hold (a power of two)
+ * @return error code
+ */
+int spsc_queue_init(spsc_queue_t* queue, size_t capacity);
+
+
+/**
+ * @brief Frees a queue
+ *
+ * @param queue queue to free
+ */
+void spsc_queue_free(spsc_queue_t* queue);
+
+
+/**
+ * @brief Appends an entry to the queue (producer side)
+ *
+ * @param queue queue to append to
+ * @param entry entry to append
+ * @return whether there was room for it
+ */
+bool spsc_queue_push(spsc_queue_t* queue, uint32_t entry);
+
+
+/**
+ * @brief Removes the oldest entry of the queue (consumer side)
+ *
+ * @param queue queue to remove from
+ * @param entry pointer to write the entry to
+ * @return whether there was an entry
+ */
+bool spsc_queue_pop(spsc_queue_t* queue, uint32_t* entry);
+
+#ifdef __cplusplus
+}
+#endif
@@ -52,6 +52,32 @@ int mem_dump_to_file(const char* filename, component_t* c)
     return ERR_NONE;
 }
 
+// ======================================================================
+int bus_dump_to_file(const char* filename, bus_t bus)
+{
+    M_REQUIRE_NON_NULL(filename);
+
+    // the whole address space, as the CPU sees it
+    static data_t content[BUS_SIZE];
+    M_REQUIRE_NO_ERR(bus_read_block(bus, 0, content, BUS_SIZE));
+
+    FILE* file = fopen(filename, "wb");
+    M_EXIT_IF(file == NULL, ERR_IO,
+              "cannot open file \"%s\" for writing (binary mode)\n", filename);
+
+    const size_t check = fwrite(content, 1, BUS_SIZE, file);
+
+    fclose(file);
+
+    if (check != BUS_SIZE) {
+        M_EXIT_ERR(ERR_IO,
+                   "was unable to dump %d bytes in file \"%s\"; wrote only " SIZE_T_FMT " bytes.\n",
+                   BUS_SIZE, filename, check);
+    }
+
+    return ERR_NONE;
+}
+
 // ======================================================================
 #define PRREG  "0x%02" PRIX8
 #define PRPAIR "0x%04" PRIX16
@@ -106,10 +132,14 @@ int main(int argc, char* argv[])
         cycle = (uint64_t) atoll(argv[2]);
     }
 
+    // only the memory and the CPU are dumped: no frame is ever requested
+    lcdc_set_render_policy(&gb.screen, LCDC_RENDER_ON_DEMAND, 0);
+
     err = gameboy_run_until(&gb, cycle);
     if (err == ERR_NONE) {
         cpu_dump_to_file("dump_cpu.txt", &(gb.cpu));
         mem_dump_to_file("dump_mem.bin", gb.components);
+        bus_dump_to_file("dump_bus.bin", gb.bus);
     }
 
     gameboy_free(&gb);
@@ -70,7 +70,7 @@ static void set_grey(guchar* pixels, int row, int col, int width, guchar grey)
 }
 
 // ======================================================================
-static void generate_image(guchar* pixels, int height, int width)
+static gboolean generate_image(guchar* pixels, int height, int width)
 {
     for (int x = 0; x < width; ++x) {
         for (int y = 0; y < height; ++y) {
@@ -83,6 +83,7 @@ static void generate_image(guchar* pixels, int height, int width)
 #pragma GCC diagnostic pop
         }
     }
+    return TRUE;
 }
 
 // ======================================================================
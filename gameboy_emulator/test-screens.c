@@ -0,0 +1,277 @@
+/**
+ * @file test-screens.c
+ * @brief Screen regression tests: runs ROMs headlessly up to given cycles
+ *        and checks the hashes of their display against a manifest,
+ *        the ROMs being run in parallel
+ *
+ * Manifest format, one screen per line (# starts a comment):
+ *     cycle hash ROM
+ * with the cycle in decimal, the hash of the display (see framebuffer_hash())
+ * in hexadecimal and the path of the ROM relative to the manifest. The screens
+ * of a ROM are on consecutive lines, by increasing cycle.
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include "gameboy.h"
+#include "framebuffer.h"
+#include "error.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> // getopt, sysconf
+
+#define MAX_ROMS 64
+#define MAX_SCREENS 16
+#define MAX_THREADS 64
+#define LINE_SIZE (FILENAME_MAX + 64)
+
+// the instrumentation writes outputs of the whole process (the timeline,
+// profile.folded, heatmap.txt): its Game Boys are then run one at a time
+#if defined(TIMELINE) || defined(PROFILER) || defined(HEATMAP)
+#define MAX_USED_THREADS 1
+#else
+#define MAX_USED_THREADS MAX_THREADS
+#endif
+
+/**
+ * @brief The screens to check of a ROM
+ */
+typedef struct
+{
+    char rom[FILENAME_MAX];
+    size_t nb_screens;
+    uint64_t cycles[MAX_SCREENS];
+    uint64_t expected[MAX_SCREENS];
+    uint64_t hashes[MAX_SCREENS];
+    int err;
+} rom_screens_t;
+
+/**
+ * @brief The ROMs, handed out to the threads one at a time
+ */
+typedef struct
+{
+    rom_screens_t roms[MAX_ROMS];
+    size_t nb_roms;
+    atomic_size_t next;
+} screen_tests_t;
+
+// ======================================================================
+static void usage(const char* pgm)
+{
+    fprintf(stderr, "usage:    %s [-j threads] [-u] manifest\n", pgm);
+    fprintf(stderr, "          -u prints the manifest with the hashes obtained\n");
+    fprintf(stderr, "          -j is ignored when built with TIMELINE, PROFILER or HEATMAP (one thread)\n");
+    fprintf(stderr, "example:  %s -j 4 tests/data/screens.txt\n", pgm);
+}
+
+// ======================================================================
+/**
+ * @brief Reads the manifest into tests (the ROMs relative to its directory)
+ */
+static int read_manifest(screen_tests_t* tests, const char* filename)
+{
+    FILE* input = fopen(filename, "r");
+    M_REQUIRE(input != NULL, ERR_IO, "cannot open \"%s\"", filename);
+
+    const char* const slash = strrchr(filename, '/');
+    const int dir_length = (slash == NULL) ? 0 : (int)(slash - filename + 1);
+
+    char line[LINE_SIZE];
+    int err = ERR_NONE;
+    while (err == ERR_NONE && fgets(line, sizeof(line), input) != NULL)
+    {
+        uint64_t cycle = 0;
+        uint64_t hash = 0;
+        char rom[FILENAME_MAX];
+        if (line[0] == '#' || sscanf(line, "%" SCNu64 " %" SCNx64 " %[^\n]", &cycle, &hash, rom) != 3)
+        {
+            continue;
+        }
+
+        char path[FILENAME_MAX];
+        if (snprintf(path, sizeof(path), "%.*s%s", dir_length, filename, rom) >= (int) sizeof(path))
+        {
+            err = ERR_BAD_PARAMETER;
+            break;
+        }
+
+        rom_screens_t* current = tests->nb_roms > 0 ? &tests->roms[tests->nb_roms - 1] : NULL;
+        if (current == NULL || strcmp(current->rom, path) != 0)
+        {
+            if (tests->nb_roms == MAX_ROMS)
+            {
+                err = ERR_BAD_PARAMETER;
+                break;
+            }
+            current = &tests->roms[tests->nb_roms++];
+            memset(current, 0, sizeof(*current));
+            strcpy(current->rom, path);
+        }
+
+        if (current->nb_screens == MAX_SCREENS
+            || (current->nb_screens > 0 && cycle <= current->cycles[current->nb_screens - 1]))
+        {
+            err = ERR_BAD_PARAMETER;
+            break;
+        }
+        current->cycles[current->nb_screens] = cycle;
+        current->expected[current->nb_screens] = hash;
+        ++current->nb_screens;
+    }
+
+    fclose(input);
+    M_REQUIRE(err == ERR_NONE, err, "invalid manifest \"%s\": too many screens, or cycles not increasing", filename);
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief Runs a ROM, hashing its display at each of its cycles
+ */
+static int run_rom(rom_screens_t* rom)
+{
+    // the whole bus and components: too large for the stack of a thread
+    gameboy_t* const gameboy = calloc(1, sizeof(gameboy_t));
+    M_EXIT_IF_NULL(gameboy, sizeof(gameboy_t));
+
+    int err = gameboy_create(gameboy, rom->rom);
+    if (err == ERR_NONE)
+    {
+        // only the frames shown at the cycles checked are rendered
+        err = lcdc_set_render_policy(&gameboy->screen, LCDC_RENDER_ON_DEMAND, 0);
+    }
+    for (size_t i = 0; err == ERR_NONE && i < rom->nb_screens; ++i)
+    {
+        err = lcdc_request_display(&gameboy->screen, rom->cycles[i]);
+        if (err == ERR_NONE)
+        {
+            err = gameboy_run_until(gameboy, rom->cycles[i]);
+        }
+        rom->hashes[i] = framebuffer_hash(image_framebuffer(&gameboy->screen.display));
+    }
+
+    gameboy_free(gameboy);
+    free(gameboy);
+    return err;
+}
+
+// ======================================================================
+static void* run_roms(void* arg)
+{
+    screen_tests_t* const tests = arg;
+    for (size_t i = atomic_fetch_add(&tests->next, 1); i < tests->nb_roms; i = atomic_fetch_add(&tests->next, 1))
+    {
+        tests->roms[i].err = run_rom(&tests->roms[i]);
+    }
+    return NULL;
+}
+
+// ======================================================================
+int main(int argc, char* argv[])
+{
+    long nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int update = 0;
+    int option = 0;
+    while ((option = getopt(argc, argv, "j:u")) != -1)
+    {
+        switch (option)
+        {
+        case 'j':
+            nb_threads = strtol(optarg, NULL, 10);
+            break;
+        case 'u':
+            update = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1 || nb_threads < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (nb_threads > MAX_USED_THREADS)
+    {
+        nb_threads = MAX_USED_THREADS;
+    }
+
+    static screen_tests_t tests;
+    int err = read_manifest(&tests, argv[optind]);
+    if (err != ERR_NONE)
+    {
+        return err;
+    }
+    atomic_init(&tests.next, 0);
+
+    pthread_t threads[MAX_THREADS];
+    long started = 0;
+    for (; nb_threads > 1 && started < nb_threads && (size_t) started < tests.nb_roms; ++started)
+    {
+        if (pthread_create(&threads[started], NULL, run_roms, &tests) != 0)
+        {
+            break;
+        }
+    }
+    if (started == 0)
+    {
+        // a single thread, or none started: all on this one
+        run_roms(&tests);
+    }
+    for (long i = 0; i < started; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // the manifest order, whatever the order the ROMs were run in
+    const char* const manifest = argv[optind];
+    const char* const slash = strrchr(manifest, '/');
+    const size_t dir_length = (slash == NULL) ? 0 : (size_t)(slash - manifest + 1);
+    size_t nb_failed = 0;
+    size_t nb_screens = 0;
+    if (update)
+    {
+        puts("# cycle hash ROM (see test-screens.c)");
+    }
+    for (size_t r = 0; r < tests.nb_roms; ++r)
+    {
+        const rom_screens_t* const rom = &tests.roms[r];
+        if (rom->err != ERR_NONE)
+        {
+            fprintf(stderr, "%s: ERROR %s\n", rom->rom, ERR_MESSAGES[rom->err - ERR_NONE]);
+            nb_failed += rom->nb_screens;
+            nb_screens += rom->nb_screens;
+            continue;
+        }
+        for (size_t i = 0; i < rom->nb_screens; ++i, ++nb_screens)
+        {
+            if (update)
+            {
+                printf("%" PRIu64 " %016" PRIx64 " %s\n", rom->cycles[i], rom->hashes[i], rom->rom + dir_length);
+            }
+            else if (rom->hashes[i] == rom->expected[i])
+            {
+                printf("%s @ %" PRIu64 ": PASSED.\n", rom->rom, rom->cycles[i]);
+            }
+            else
+            {
+                printf("%s @ %" PRIu64 ": FAILED (hash %016" PRIx64 ", expected %016" PRIx64 ").\n",
+                       rom->rom, rom->cycles[i], rom->hashes[i], rom->expected[i]);
+                ++nb_failed;
+            }
+        }
+    }
+    if (!update)
+    {
+        printf("%zu screens, %zu failed\n", nb_screens, nb_failed);
+    }
+    return nb_failed == 0 ? 0 : 1;
+}
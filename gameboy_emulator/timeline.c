@@ -0,0 +1,93 @@
+/**
+ * @file timeline.c
+ * @brief Timeline of the emulator phases, written as Chrome trace events
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "timeline.h"
+#include "error.h"
+
+// tracks of the timeline
+#define TID_MAIN   1
+#define TID_FRAMES 2
+
+static FILE* output = NULL;
+static unsigned int nb_users = 0;
+static struct timespec origin;
+static double frame_start = 0.0;
+
+// ======================================================================
+/**
+ * @brief Time elapsed since the opening of the timeline, in microseconds
+ */
+static double timeline_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - origin.tv_sec) * 1e6 + (double)(now.tv_nsec - origin.tv_nsec) / 1e3;
+}
+
+static void timeline_track_name(int tid, const char* name)
+{
+    fprintf(output, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            tid, name);
+}
+
+int timeline_open(const char* filename)
+{
+    M_REQUIRE_NON_NULL(filename);
+
+    if (NULL == output)
+    {
+        output = fopen(filename, "w");
+        if (NULL == output)
+        {
+            return ERR_IO;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &origin);
+        frame_start = 0.0;
+        fputs("[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"gameboy\"}}", output);
+        timeline_track_name(TID_MAIN, "emulator");
+        timeline_track_name(TID_FRAMES, "emulated frames");
+    }
+    ++nb_users;
+    return ERR_NONE;
+}
+
+void timeline_event(char phase, const char* name, const char* category)
+{
+    if (NULL != output)
+    {
+        fprintf(output, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d%s}",
+                name, category, phase, timeline_now(), TID_MAIN,
+                TIMELINE_INSTANT == phase ? ",\"s\":\"t\"" : "");
+    }
+}
+
+void timeline_end_frame(uint64_t frame)
+{
+    if (NULL != output)
+    {
+        // frames span several run_until calls, hence complete events on their own track
+        const double now = timeline_now();
+        fprintf(output, ",\n{\"name\":\"frame %" PRIu64 "\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                frame, frame_start, now - frame_start, TID_FRAMES);
+        frame_start = now;
+    }
+}
+
+void timeline_close(void)
+{
+    if (NULL != output && 0 == --nb_users)
+    {
+        fputs("\n]\n", output);
+        fclose(output);
+        output = NULL;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+/**
+ * @file timeline.h
+ * @brief Timeline of the emulator phases, written as Chrome trace events
+ *        (JSON, to be opened in chrome://tracing or ui.perfetto.dev)
+ *
+ * The timeline is global, so that the frontend (sidlib, gbsimulator) and
+ * the core can both write to it; writing to a closed timeline does nothing.
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default output file
+#ifndef TIMELINE_OUTPUT
+#define TIMELINE_OUTPUT "timeline.json"
+#endif
+
+/**
+ * @brief Event phases (see the Trace Event Format)
+ */
+#define TIMELINE_BEGIN   'B'
+#define TIMELINE_END     'E'
+#define TIMELINE_INSTANT 'i'
+
+
+/**
+ * @brief Opens the timeline (opening it again only counts one more user)
+ *
+ * @param filename file to write the events to
+ * @return error code
+ */
+int timeline_open(const char* filename);
+
+
+/**
+ * @brief Writes an event of the current time on the main track
+ *
+ * @param phase TIMELINE_BEGIN or TIMELINE_END of a span, or TIMELINE_INSTANT
+ * @param name name of the event
+ * @param category category of the event
+ */
+void timeline_event(char phase, const char* name, const char* category);
+
+
+/**
+ * @brief Ends the span of the current emulated frame (on its own track)
+ *        and starts the next one
+ *
+ * @param frame number of the frame which ends
+ */
+void timeline_end_frame(uint64_t frame);
+
+
+/**
+ * @brief Closes the timeline (once its last user closes it)
+ */
+void timeline_close(void);
+
+
+/**
+ * @brief Macros to instrument the code, vanishing without TIMELINE
+ */
+#ifdef TIMELINE
+#define timeline_begin(name, category) timeline_event(TIMELINE_BEGIN, name, category)
+#define timeline_end(name, category) timeline_event(TIMELINE_END, name, category)
+#define timeline_instant(name, category) timeline_event(TIMELINE_INSTANT, name, category)
+#define timeline_frame(frame) timeline_end_frame(frame)
+#else
+#define timeline_begin(name, category) do {} while(0)
+#define timeline_end(name, category) do {} while(0)
+#define timeline_instant(name, category) do {} while(0)
+#define timeline_frame(frame) do {} while(0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file timing.c
+ * @brief Host time accounting of the emulator stages
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <inttypes.h>
+
+#include "timing.h"
+#include "error.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc
+#define HAS_TSC
+#endif
+
+#define NS_PER_S 1000000000ULL
+
+static const char* const STAGE_NAMES[TIMING_STAGE_COUNT] = {
+    "cpu", "timer", "lcdc", "listeners", "image"
+};
+
+static uint64_t timespec_to_ns(const struct timespec* t)
+{
+    return (uint64_t)t->tv_sec * NS_PER_S + (uint64_t)t->tv_nsec;
+}
+
+uint64_t timing_ticks(void)
+{
+#ifdef HAS_TSC
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespec_to_ns(&now);
+#endif
+}
+
+int timing_init(timing_t* timing, const char* filename)
+{
+    M_REQUIRE_NON_NULL(timing);
+    M_REQUIRE_NON_NULL(filename);
+
+    *timing = (timing_t) { 0 };
+    timing->output = fopen(filename, "w");
+    if (NULL == timing->output)
+    {
+        return ERR_IO;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &timing->start_time);
+    timing->start_ticks = timing_ticks();
+    timing->ns_per_tick = 1.0;
+    return ERR_NONE;
+}
+
+uint64_t timing_add(timing_t* timing, timing_stage_t stage, uint64_t from)
+{
+    const uint64_t now = timing_ticks();
+    timing->frame[stage] += now - from;
+    return now;
+}
+
+// ======================================================================
+/**
+ * @brief Updates the ticks to nanoseconds ratio with the time elapsed since init
+ *        (one clock_gettime per frame instead of one per measure)
+ */
+static void timing_calibrate(timing_t* timing)
+{
+#ifdef HAS_TSC
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const uint64_t ticks = timing_ticks() - timing->start_ticks;
+    if (ticks > 0)
+    {
+        timing->ns_per_tick = (double)(timespec_to_ns(&now) - timespec_to_ns(&timing->start_time)) / (double)ticks;
+    }
+#else
+    (void)timing;
+#endif
+}
+
+#define ticks_to_ns(timing, ticks) ((uint64_t)((double)(ticks) * (timing)->ns_per_tick))
+
+void timing_end_frame(timing_t* timing)
+{
+    if (NULL == timing || NULL == timing->output)
+    {
+        return;
+    }
+
+    timing_calibrate(timing);
+    uint64_t frame_total = 0;
+    fprintf(timing->output, "frame %" PRIu64 ":", timing->nb_frames);
+    for (timing_stage_t s = 0; s < TIMING_STAGE_COUNT; ++s)
+    {
+        fprintf(timing->output, " %s %" PRIu64, STAGE_NAMES[s], ticks_to_ns(timing, timing->frame[s]));
+        frame_total += timing->frame[s];
+        timing->total[s] += timing->frame[s];
+        timing->frame[s] = 0;
+    }
+    fprintf(timing->output, " total %" PRIu64 " (ns)\n", ticks_to_ns(timing, frame_total));
+    ++timing->nb_frames;
+}
+
+void timing_free(timing_t* timing)
+{
+    if (NULL == timing || NULL == timing->output)
+    {
+        return;
+    }
+
+    timing_calibrate(timing);
+    uint64_t total = 0;
+    for (timing_stage_t s = 0; s < TIMING_STAGE_COUNT; ++s)
+    {
+        // the last frame may be incomplete
+        timing->total[s] += timing->frame[s];
+        total += timing->total[s];
+    }
+
+    fprintf(timing->output, "total over %" PRIu64 " frames:\n", timing->nb_frames);
+    for (timing_stage_t s = 0; s < TIMING_STAGE_COUNT; ++s)
+    {
+        const uint64_t ns = ticks_to_ns(timing, timing->total[s]);
+        fprintf(timing->output, "  %-10s %14" PRIu64 " ns  %12" PRIu64 " ns/frame  %5.1f %%\n",
+                STAGE_NAMES[s], ns, timing->nb_frames ? ns / timing->nb_frames : ns,
+                total ? 100.0 * (double)timing->total[s] / (double)total : 0.0);
+    }
+    fprintf(timing->output, "  %-10s %14" PRIu64 " ns\n", "total", ticks_to_ns(timing, total));
+
+    fclose(timing->output);
+    *timing = (timing_t) { 0 };
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+/**
+ * @file timing.h
+ * @brief Host time accounting of the emulator stages (CPU, timer, LCDC, ...)
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default output file of the per-frame and total reports
+#ifndef TIMING_OUTPUT
+#define TIMING_OUTPUT "timing.txt"
+#endif
+
+/**
+ * @brief Stages host time is attributed to
+ */
+typedef enum {
+    TIMING_CPU, TIMING_TIMER, TIMING_LCDC, TIMING_LISTENERS, TIMING_IMAGE,
+    TIMING_STAGE_COUNT
+} timing_stage_t;
+
+/**
+ * @brief Time accounting type.
+ *        Stages are measured in ticks (TSC when available, nanoseconds otherwise),
+ *        converted to nanoseconds once per frame against the monotonic clock.
+ */
+typedef struct {
+    FILE* output;
+    uint64_t total[TIMING_STAGE_COUNT];
+    uint64_t frame[TIMING_STAGE_COUNT];
+    uint64_t nb_frames;
+    uint64_t start_ticks;
+    struct timespec start_time;
+    double ns_per_tick;
+} timing_t;
+
+
+/**
+ * @brief Current host time, in ticks
+ */
+uint64_t timing_ticks(void);
+
+
+/**
+ * @brief Initiates time accounting
+ *
+ * @param timing time accounting to initiate
+ * @param filename file to write the reports to
+ * @return error code
+ */
+int timing_init(timing_t* timing, const char* filename);
+
+
+/**
+ * @brief Attributes the time elapsed since a previous tick to a stage
+ *
+ * @param timing time accounting
+ * @param stage the stage which ran since from
+ * @param from tick at which the stage started
+ * @return the current tick, i.e. the start of the next stage
+ */
+uint64_t timing_add(timing_t* timing, timing_stage_t stage, uint64_t from);
+
+
+/**
+ * @brief Ends a frame: reports its breakdown and adds it to the totals
+ *
+ * @param timing time accounting
+ */
+void timing_end_frame(timing_t* timing);
+
+
+/**
+ * @brief Reports the totals and frees time accounting
+ *
+ * @param timing time accounting to free
+ */
+void timing_free(timing_t* timing);
+
+
+/**
+ * @brief Macros to instrument a sequence of stages, vanishing without TIMING:
+ *            timing_start(t); stage_1(); timing_lap(t, STAGE_1); stage_2(); timing_lap(t, STAGE_2);
+ */
+#ifdef TIMING
+#define timing_start(timing) uint64_t timing_tick_ = timing_ticks()
+#define timing_lap(timing, stage) timing_tick_ = timing_add(timing, stage, timing_tick_)
+#else
+#define timing_start(timing) do {} while(0)
+#define timing_lap(timing, stage) do {} while(0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
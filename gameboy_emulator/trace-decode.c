@@ -0,0 +1,36 @@
+/**
+ * @file trace-decode.c
+ * @brief Prints a binary instruction trace (see trace.h), one instruction per line
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdio.h>
+
+#include "trace.h"
+#include "error.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s trace_file\n", argv[0]);
+        return 1;
+    }
+
+    FILE* input = fopen(argv[1], "rb");
+    if (NULL == input)
+    {
+        fprintf(stderr, "cannot open \"%s\"\n", argv[1]);
+        return ERR_IO;
+    }
+
+    const int err = trace_decode(input, stdout);
+    fclose(input);
+    if (ERR_NONE != err)
+    {
+        fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+    }
+    return err;
+}
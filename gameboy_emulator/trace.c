@@ -0,0 +1,299 @@
+/**
+ * @file trace.c
+ * @brief Binary trace of the executed instructions, kept in a ring buffer
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "trace.h"
+#include "cpu-storage.h"
+#include "opcode.h"
+#include "error.h"
+
+// flags + PC + opcode + prefixed opcode + 5 register pairs + cycles (10 bytes varint)
+#define TRACE_RECORD_MAX (1 + 2 + 1 + 1 + 5 * 2 + 10)
+
+#define TRACE_MAGIC_SIZE 4
+
+int trace_init(trace_t* trace)
+{
+    M_REQUIRE_NON_NULL(trace);
+
+    *trace = (trace_t) { 0 };
+    trace->blocks = calloc(TRACE_NB_BLOCKS, TRACE_BLOCK_SIZE);
+    if (NULL == trace->blocks)
+    {
+        return ERR_MEM;
+    }
+    trace->nb_blocks = 1;
+    return ERR_NONE;
+}
+
+// ======================================================================
+static uint8_t* trace_put16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)(value & 0xFF);
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+static uint8_t* trace_put_varint(uint8_t* p, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+#define put_reg(flag, reg) \
+    if (cpu->reg != last->reg) \
+    { \
+        flags |= flag; \
+        p = trace_put16(p, cpu->reg); \
+        last->reg = cpu->reg; \
+    }
+
+int trace_cycle(trace_t* trace, const cpu_t* cpu, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(trace);
+    M_REQUIRE_NON_NULL(cpu);
+    M_REQUIRE_NON_NULL(trace->blocks);
+
+    const bool interrupt = cpu->IME && (cpu->IF & cpu->IE);
+    // nothing starts while an instruction is running or the CPU is halted
+    if (0 != cpu->idle_time || (cpu->HALT && !(cpu->IF & cpu->IE)))
+    {
+        return ERR_NONE;
+    }
+
+    if (trace->lengths[trace->current] + TRACE_RECORD_MAX > TRACE_BLOCK_SIZE)
+    {
+        // next block (overwriting the oldest one once the ring is full), from a zeroed state
+        trace->current = (trace->current + 1) % TRACE_NB_BLOCKS;
+        trace->lengths[trace->current] = 0;
+        if (trace->nb_blocks < TRACE_NB_BLOCKS)
+        {
+            ++trace->nb_blocks;
+        }
+        trace->last = (trace_state_t) { 0 };
+    }
+
+    trace_state_t* last = &trace->last;
+    uint8_t* const start = trace->blocks + trace->current * TRACE_BLOCK_SIZE + trace->lengths[trace->current];
+    uint8_t* p = start + 1;
+    uint8_t flags = interrupt ? TRACE_FLAG_INTERRUPT : 0;
+
+    if (cpu->PC != last->next_PC)
+    {
+        flags |= TRACE_FLAG_PC;
+        p = trace_put16(p, cpu->PC);
+    }
+
+    const data_t opcode = cpu_read_at_idx(cpu, cpu->PC);
+    *p++ = opcode;
+    const instruction_t* lu = &instruction_direct[opcode];
+    if (PREFIXED == opcode)
+    {
+        const data_t prefixed = cpu_read_at_idx(cpu, (addr_t)(cpu->PC + 1));
+        *p++ = prefixed;
+        lu = &instruction_prefixed[prefixed];
+    }
+    last->next_PC = (addr_t)(cpu->PC + lu->bytes);
+
+    put_reg(TRACE_FLAG_AF, AF);
+    put_reg(TRACE_FLAG_BC, BC);
+    put_reg(TRACE_FLAG_DE, DE);
+    put_reg(TRACE_FLAG_HL, HL);
+    put_reg(TRACE_FLAG_SP, SP);
+
+    p = trace_put_varint(p, cycle - last->cycle);
+    last->cycle = cycle;
+
+    *start = flags;
+    trace->lengths[trace->current] += (uint32_t)(p - start);
+    return ERR_NONE;
+}
+
+#undef put_reg
+
+// ======================================================================
+static int trace_write32(FILE* file, uint32_t value)
+{
+    uint8_t bytes[4];
+    trace_put16(trace_put16(bytes, (uint16_t)(value & 0xFFFF)), (uint16_t)(value >> 16));
+    return fwrite(bytes, 1, 4, file) == 4 ? ERR_NONE : ERR_IO;
+}
+
+int trace_dump(const trace_t* trace, const char* filename)
+{
+    M_REQUIRE_NON_NULL(trace);
+    M_REQUIRE_NON_NULL(filename);
+    M_REQUIRE_NON_NULL(trace->blocks);
+
+    FILE* file = fopen(filename, "wb");
+    if (NULL == file)
+    {
+        return ERR_IO;
+    }
+
+    int err = ERR_NONE;
+    const uint8_t header[] = {
+        TRACE_MAGIC[0], TRACE_MAGIC[1], TRACE_MAGIC[2], TRACE_MAGIC[3], TRACE_VERSION,
+        TRACE_BLOCK_SIZE & 0xFF, (TRACE_BLOCK_SIZE >> 8) & 0xFF,
+        (TRACE_BLOCK_SIZE >> 16) & 0xFF, (TRACE_BLOCK_SIZE >> 24) & 0xFF
+    };
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header))
+    {
+        err = ERR_IO;
+    }
+
+    // the oldest block follows the current one once the ring is full
+    const size_t first = (trace->current + TRACE_NB_BLOCKS + 1 - trace->nb_blocks) % TRACE_NB_BLOCKS;
+    for (size_t i = 0; i < trace->nb_blocks && ERR_NONE == err; ++i)
+    {
+        const size_t block = (first + i) % TRACE_NB_BLOCKS;
+        const uint32_t length = trace->lengths[block];
+        err = trace_write32(file, length);
+        if (ERR_NONE == err && fwrite(trace->blocks + block * TRACE_BLOCK_SIZE, 1, length, file) != length)
+        {
+            err = ERR_IO;
+        }
+    }
+
+    fclose(file);
+    return err;
+}
+
+// ======================================================================
+static uint16_t trace_get16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t trace_get32(const uint8_t* p)
+{
+    return (uint32_t)trace_get16(p) | (uint32_t)trace_get16(p + 2) << 16;
+}
+
+#define get_reg(flag, reg) \
+    if (flags & flag) \
+    { \
+        M_REQUIRE(p + 2 <= end, ERR_IO, "%s", "truncated record"); \
+        state->reg = trace_get16(p); \
+        p += 2; \
+    }
+
+/**
+ * @brief Decodes the records of one block
+ */
+static int trace_decode_block(const uint8_t* p, const uint8_t* end, FILE* output)
+{
+    trace_state_t block_state = { 0 };
+    trace_state_t* state = &block_state;
+    while (p < end)
+    {
+        const uint8_t flags = *p++;
+        addr_t PC = state->next_PC;
+        if (flags & TRACE_FLAG_PC)
+        {
+            M_REQUIRE(p + 2 <= end, ERR_IO, "%s", "truncated record");
+            PC = trace_get16(p);
+            p += 2;
+        }
+
+        M_REQUIRE(p < end, ERR_IO, "%s", "truncated record");
+        const data_t opcode = *p++;
+        const instruction_t* lu = &instruction_direct[opcode];
+        int prefixed = -1;
+        if (PREFIXED == opcode)
+        {
+            M_REQUIRE(p < end, ERR_IO, "%s", "truncated record");
+            prefixed = *p++;
+            lu = &instruction_prefixed[prefixed];
+        }
+        state->next_PC = (addr_t)(PC + lu->bytes);
+
+        get_reg(TRACE_FLAG_AF, AF);
+        get_reg(TRACE_FLAG_BC, BC);
+        get_reg(TRACE_FLAG_DE, DE);
+        get_reg(TRACE_FLAG_HL, HL);
+        get_reg(TRACE_FLAG_SP, SP);
+
+        uint64_t delta = 0;
+        unsigned int shift = 0;
+        do
+        {
+            M_REQUIRE(p < end && shift < 64, ERR_IO, "%s", "truncated record");
+            delta |= (uint64_t)(*p & 0x7F) << shift;
+            shift += 7;
+        } while (*p++ & 0x80);
+        state->cycle += delta;
+
+        fprintf(output, "%12" PRIu64 " PC=%04" PRIX16 " OP=%02" PRIX8, state->cycle, PC, opcode);
+        if (prefixed >= 0)
+        {
+            fprintf(output, " %02X", prefixed);
+        }
+        fprintf(output, " AF=%04" PRIX16 " BC=%04" PRIX16 " DE=%04" PRIX16 " HL=%04" PRIX16 " SP=%04" PRIX16 "%s\n",
+                state->AF, state->BC, state->DE, state->HL, state->SP,
+                (flags & TRACE_FLAG_INTERRUPT) ? " INT" : "");
+    }
+    return ERR_NONE;
+}
+
+#undef get_reg
+
+int trace_decode(FILE* input, FILE* output)
+{
+    M_REQUIRE_NON_NULL(input);
+    M_REQUIRE_NON_NULL(output);
+
+    uint8_t header[TRACE_MAGIC_SIZE + 1 + 4];
+    M_REQUIRE(fread(header, 1, sizeof(header), input) == sizeof(header)
+              && 0 == memcmp(header, TRACE_MAGIC, TRACE_MAGIC_SIZE),
+              ERR_IO, "%s", "not a trace dump");
+    M_REQUIRE(TRACE_VERSION == header[TRACE_MAGIC_SIZE], ERR_IO, "%s", "unsupported trace version");
+    const uint32_t block_size = trace_get32(&header[TRACE_MAGIC_SIZE + 1]);
+
+    uint8_t* block = malloc(block_size);
+    if (NULL == block)
+    {
+        return ERR_MEM;
+    }
+
+    int err = ERR_NONE;
+    uint8_t length_bytes[4];
+    while (ERR_NONE == err && fread(length_bytes, 1, 4, input) == 4)
+    {
+        const uint32_t length = trace_get32(length_bytes);
+        if (length > block_size || fread(block, 1, length, input) != length)
+        {
+            err = ERR_IO;
+        }
+        else
+        {
+            err = trace_decode_block(block, block + length, output);
+        }
+    }
+
+    free(block);
+    return err;
+}
+
+// ======================================================================
+void trace_free(trace_t* trace)
+{
+    if (NULL != trace)
+    {
+        free(trace->blocks);
+        *trace = (trace_t) { 0 };
+    }
+}
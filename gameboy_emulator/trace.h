@@ -0,0 +1,136 @@
+#pragma once
+
+/**
+ * @file trace.h
+ * @brief Binary trace of the executed instructions, kept in a ring buffer
+ *
+ * The ring is made of fixed-size blocks. Each record is delta-encoded against
+ * the previous one of its block: a flags byte, the absolute PC only when it is
+ * not the address following the previous instruction, the opcode (and its
+ * CB-prefixed byte), the register pairs which changed and the number of cycles
+ * since the previous record (as a LEB128 varint). Each block starts from a
+ * zeroed state, so that the oldest blocks can be overwritten and any block
+ * decoded on its own.
+ *
+ * Dump file format (little-endian):
+ *   "GBTR", version (1 byte), block size (4 bytes),
+ *   then, oldest first, for each block: its length (4 bytes) and its records.
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "memory.h"
+#include "cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of a block and number of blocks of the ring (default: 1 MiB)
+#ifndef TRACE_BLOCK_SIZE
+#define TRACE_BLOCK_SIZE 4096
+#endif
+#ifndef TRACE_NB_BLOCKS
+#define TRACE_NB_BLOCKS 256
+#endif
+
+// Default dump file
+#ifndef TRACE_OUTPUT
+#define TRACE_OUTPUT "trace.bin"
+#endif
+
+#define TRACE_MAGIC "GBTR"
+#define TRACE_VERSION 2
+
+/**
+ * @brief Flags of a record, telling which fields follow
+ */
+#define TRACE_FLAG_PC        0x01 // PC is not the one following the previous instruction
+#define TRACE_FLAG_AF        0x02
+#define TRACE_FLAG_BC        0x04
+#define TRACE_FLAG_DE        0x08
+#define TRACE_FLAG_HL        0x10
+#define TRACE_FLAG_SP        0x20
+#define TRACE_FLAG_INTERRUPT 0x40 // an interrupt is served instead of the instruction
+
+/**
+ * @brief State a record is encoded against
+ */
+typedef struct {
+    addr_t next_PC;
+    uint16_t AF;
+    uint16_t BC;
+    uint16_t DE;
+    uint16_t HL;
+    uint16_t SP;
+    uint64_t cycle;
+} trace_state_t;
+
+/**
+ * @brief Trace type
+ */
+typedef struct {
+    uint8_t* blocks;
+    uint32_t lengths[TRACE_NB_BLOCKS];
+    size_t current;
+    size_t nb_blocks;
+    trace_state_t last;
+} trace_t;
+
+
+/**
+ * @brief Initiates a trace (allocates its ring buffer)
+ *
+ * @param trace trace to initiate
+ * @return error code
+ */
+int trace_init(trace_t* trace);
+
+
+/**
+ * @brief Records the instruction the CPU is about to start, if any
+ *        (to be called before each CPU cycle)
+ *
+ * @param trace trace to record into
+ * @param cpu CPU about to run its cycle
+ * @param cycle the current cycle number
+ * @return error code
+ */
+int trace_cycle(trace_t* trace, const cpu_t* cpu, uint64_t cycle);
+
+
+/**
+ * @brief Writes the content of the ring buffer to a file
+ *
+ * @param trace trace to dump
+ * @param filename file to write to
+ * @return error code
+ */
+int trace_dump(const trace_t* trace, const char* filename);
+
+
+/**
+ * @brief Decodes a dump file, one line per instruction
+ *
+ * @param input dump to read
+ * @param output where to write the decoded instructions
+ * @return error code
+ */
+int trace_decode(FILE* input, FILE* output);
+
+
+/**
+ * @brief Frees a trace
+ *
+ * @param trace trace to free
+ */
+void trace_free(trace_t* trace);
+
+#ifdef __cplusplus
+}
+#endif
@@ -895,6 +895,134 @@ START_TEST(bit_vector_deadboss)
 }
 END_TEST
 
+#define NB_RANDOM_TESTS 64
+#define MAX_RANDOM_SIZE 1000
+
+static bit_vector_t* random_vector(size_t size)
+{
+    bit_vector_t* pbv = bit_vector_create(size, 0);
+    ck_assert_ptr_nonnull(pbv);
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (rand() & 1)
+        {
+            pbv->content[i / IMAGE_LINE_WORD_BITS] |= UINT32_C(1) << (i % IMAGE_LINE_WORD_BITS);
+        }
+    }
+    return pbv;
+}
+
+START_TEST(bit_vector_random_sizes)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    // sizes spanning several vector widths, most not multiples of a word,
+    // checked bit by bit (the bits past the size must stay 0)
+    for (int t = 0; t < NB_RANDOM_TESTS; ++t)
+    {
+        const size_t size = 1 + (size_t)rand() % MAX_RANDOM_SIZE;
+        const size_t words = (size + IMAGE_LINE_WORD_BITS - 1) / IMAGE_LINE_WORD_BITS;
+        bit_vector_t* pbv1 = random_vector(size);
+        bit_vector_t* pbv2 = random_vector(size);
+
+        bit_vector_t* pnot = bit_vector_not(bit_vector_cpy(pbv1));
+        bit_vector_t* pand = bit_vector_and(bit_vector_cpy(pbv1), pbv2);
+        bit_vector_t* por = bit_vector_or(bit_vector_cpy(pbv1), pbv2);
+        bit_vector_t* pxor = bit_vector_xor(bit_vector_cpy(pbv1), pbv2);
+        const int64_t shift = rand() % (int64_t)(size + 1);
+        bit_vector_t* pjoin = bit_vector_join(pbv1, pbv2, shift);
+        const int64_t index = rand() % (int64_t)(3 * size) - (int64_t)size;
+        bit_vector_t* pext = bit_vector_extract_zero_ext(pbv1, index, size);
+        const size_t wrap_size = 1 + (size_t)rand() % MAX_RANDOM_SIZE;
+        bit_vector_t* pwrap = bit_vector_extract_wrap_ext(pbv1, index, wrap_size);
+        ck_assert_ptr_nonnull(pwrap);
+        for (size_t i = 0; i < wrap_size; ++i)
+        {
+            const int64_t from = ((index + (int64_t)i) % (int64_t)size + (int64_t)size) % (int64_t)size;
+            ck_assert_int_eq(bit_vector_get(pwrap, i), bit_vector_get(pbv1, (size_t)from));
+        }
+        for (size_t i = wrap_size; i % IMAGE_LINE_WORD_BITS != 0; ++i)
+        {
+            ck_assert_int_eq((pwrap->content[i / 32] >> (i % 32)) & 1, 0);
+        }
+
+        for (size_t i = 0; i < words * IMAGE_LINE_WORD_BITS; ++i)
+        {
+            const bit_t b1 = bit_vector_get(pbv1, i);
+            const bit_t b2 = bit_vector_get(pbv2, i);
+            const bit_t in = i < size;
+            const int64_t from = index + (int64_t)i;
+            ck_assert_int_eq((pnot->content[i / 32] >> (i % 32)) & 1, in & !b1);
+            ck_assert_int_eq((pand->content[i / 32] >> (i % 32)) & 1, b1 & b2);
+            ck_assert_int_eq((por->content[i / 32] >> (i % 32)) & 1, b1 | b2);
+            ck_assert_int_eq((pxor->content[i / 32] >> (i % 32)) & 1, b1 ^ b2);
+            ck_assert_int_eq((pjoin->content[i / 32] >> (i % 32)) & 1, (int64_t)i < shift ? b1 : b2);
+            ck_assert_int_eq((pext->content[i / 32] >> (i % 32)) & 1,
+                             in && from >= 0 ? bit_vector_get(pbv1, (size_t)from) : 0);
+        }
+
+        bit_vector_free(&pnot);
+        bit_vector_free(&pand);
+        bit_vector_free(&por);
+        bit_vector_free(&pxor);
+        bit_vector_free(&pjoin);
+        bit_vector_free(&pext);
+        bit_vector_free(&pwrap);
+        bit_vector_free(&pbv1);
+        bit_vector_free(&pbv2);
+    }
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(bit_vector_pool_reuse)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    bit_vector_pool_reset();
+
+    // a freed vector is reused by the next one of its size class, fully initialized
+    bit_vector_t* pbv = bit_vector_create(160, 1);
+    ck_assert_ptr_nonnull(pbv);
+    bit_vector_t* const first = pbv;
+    bit_vector_free(&pbv);
+    ck_assert_ptr_null(pbv);
+    pbv = bit_vector_create(200, 0);
+    ck_assert_ptr_eq(pbv, first);
+    ck_assert_uint_eq(pbv->size, 200);
+    for (size_t i = 0; i < 200 / IMAGE_LINE_WORD_BITS + 1; ++i)
+    {
+        ck_assert_uint_eq(pbv->content[i], 0);
+    }
+
+    // a vector of a larger class can be created and freed with the others
+    bit_vector_t* large = bit_vector_create(1000, 1);
+    ck_assert_ptr_nonnull(large);
+    bit_vector_t* small = bit_vector_extract_zero_ext(large, 0, 1);
+    ck_assert_ptr_nonnull(small);
+    ck_assert_uint_eq(small->content[0], 1);
+    bit_vector_free(&large);
+    bit_vector_free(&small);
+    bit_vector_free(&pbv);
+
+    // vectors in use are kept by a reset
+    pbv = bit_vector_create(256, 1);
+    bit_vector_pool_reset();
+    ck_assert_uint_eq(bit_vector_get(pbv, 255), 1);
+    bit_vector_free(&pbv);
+    bit_vector_pool_reset();
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
 Suite* cartridge_test_suite()
 {
 
@@ -920,6 +1048,8 @@ Suite* cartridge_test_suite()
     tcase_add_test(tc1, bit_vector_join_exec);
     tcase_add_test(tc1, bit_vector_various);
     tcase_add_test(tc1, bit_vector_deadboss);
+    tcase_add_test(tc1, bit_vector_random_sizes);
+    tcase_add_test(tc1, bit_vector_pool_reuse);
 
     return s;
 }
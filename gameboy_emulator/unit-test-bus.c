@@ -15,6 +15,7 @@
 #ifdef WITH_PRINT
 #include <stdio.h>
 #endif
+#include <string.h> // memcmp
 
 #include <check.h>
 #include <inttypes.h>
@@ -210,6 +211,97 @@ START_TEST(bus_write_exec)
 END_TEST
 
 
+START_TEST(bus_read_block_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    component_t c2;
+    zero_init_var(c2);
+    ck_assert_int_eq(component_create(&c, 256), ERR_NONE);
+    ck_assert_int_eq(component_create(&c2, 256), ERR_NONE);
+
+    // two adjacent components, then an unmapped range and the end of the bus
+    ck_assert_int_eq(bus_plug(bus, &c, 0x1000, 0x10FF), ERR_NONE);
+    ck_assert_int_eq(bus_plug(bus, &c2, 0x1100, 0x11FF), ERR_NONE);
+    component_t echo = c;
+    ck_assert_int_eq(bus_forced_plug(bus, &echo, 0xFF80, 0xFFFF, 0x80), ERR_NONE);
+    for (size_t i = 0; i < 256; ++i) {
+        *bus[0x1000 + i] = (data_t) rand();
+        *bus[0x1100 + i] = (data_t) rand();
+    }
+
+    const addr_t starts[] = { 0x1000, 0x10F0, 0x0FF0, 0x11F8, 0xFF00, 0xFFF0 };
+    data_t block[600];
+    for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); ++s) {
+        ck_assert_int_eq(bus_read_block(bus, starts[s], block, sizeof(block)), ERR_NONE);
+        for (size_t i = 0; i < sizeof(block); ++i) {
+            data_t data = 0;
+            ck_assert_int_eq(bus_read(bus, (addr_t) (starts[s] + i), &data), ERR_NONE);
+            ck_assert_int_eq(block[i], data);
+        }
+    }
+    ck_assert_int_eq(bus_read_block(bus, 0, block, 0), ERR_NONE);
+    ck_assert_int_eq(bus_read_block(bus, 0, NULL, 1), ERR_BAD_PARAMETER);
+    ck_assert_int_eq(bus_read_block(bus, 0, block, BUS_SIZE + 1), ERR_BAD_PARAMETER);
+
+    component_free(&c);
+    component_free(&c2);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+
+START_TEST(bus_write_block_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    component_t c2;
+    zero_init_var(c2);
+    ck_assert_int_eq(component_create(&c, 256), ERR_NONE);
+    ck_assert_int_eq(component_create(&c2, 256), ERR_NONE);
+
+    ck_assert_int_eq(bus_plug(bus, &c, 0x1000, 0x10FF), ERR_NONE);
+    ck_assert_int_eq(bus_plug(bus, &c2, 0x1100, 0x11FF), ERR_NONE);
+
+    data_t block[512];
+    data_t read[512];
+    for (size_t i = 0; i < sizeof(block); ++i) {
+        block[i] = (data_t) rand();
+    }
+
+    // across the two components
+    ck_assert_int_eq(bus_write_block(bus, 0x1000, block, sizeof(block)), ERR_NONE);
+    ck_assert_int_eq(bus_read_block(bus, 0x1000, read, sizeof(read)), ERR_NONE);
+    ck_assert_int_eq(memcmp(block, read, sizeof(block)), 0);
+
+    // partly unmapped: nothing is written
+    ck_assert_int_eq(bus_write_block(bus, 0x1100, read + 1, 257), ERR_BAD_PARAMETER);
+    ck_assert_int_eq(bus_read_block(bus, 0x1000, read, sizeof(read)), ERR_NONE);
+    ck_assert_int_eq(memcmp(block, read, sizeof(block)), 0);
+
+    ck_assert_int_eq(bus_write_block(bus, 0x1000, block, 0), ERR_NONE);
+    ck_assert_int_eq(bus_write_block(bus, 0x1000, NULL, 1), ERR_BAD_PARAMETER);
+    ck_assert_int_eq(bus_write_block(bus, 0x1000, block, BUS_SIZE + 1), ERR_BAD_PARAMETER);
+
+    component_free(&c);
+    component_free(&c2);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+
 Suite* bus_test_suite()
 {
 #pragma GCC diagnostic push
@@ -227,9 +319,11 @@ Suite* bus_test_suite()
 
     tcase_add_test(tc3, bus_read_err);
     tcase_add_test(tc3, bus_read_exec);
+    tcase_add_test(tc3, bus_read_block_exec);
 
     tcase_add_test(tc3, bus_write_err);
     tcase_add_test(tc3, bus_write_exec);
+    tcase_add_test(tc3, bus_write_block_exec);
 
     return s;
 }
@@ -0,0 +1,489 @@
+/**
+ * @file unit-test-framebuffer.c
+ * @brief Unit test code for the packed framebuffer, checked against image lines
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "tests.h"
+#include "framebuffer.h"
+#include "image.h"
+
+#define WIDTH 160
+#define HEIGHT 4
+#define NB_RANDOM_TESTS 64
+
+// ======================================================================
+static void random_image_line(image_line_t* iml)
+{
+    ck_assert_err_none(image_line_create(iml, WIDTH));
+    for (size_t i = 0; i < WIDTH / IMAGE_LINE_WORD_BITS; ++i)
+    {
+        ck_assert_err_none(image_line_set_word(iml, i, (uint32_t)rand() ^ ((uint32_t)rand() << 16),
+                                               (uint32_t)rand() ^ ((uint32_t)rand() << 16)));
+    }
+}
+
+/**
+ * @brief Checks that a line of a framebuffer holds the pixels of an image line
+ */
+static void assert_same_line(pixel_line_t pl, image_line_t iml)
+{
+    ck_assert_uint_eq(pl.size, iml.msb->size);
+    for (size_t x = 0; x < pl.size; ++x)
+    {
+        const uint8_t color = (uint8_t)(bit_vector_get(iml.msb, x) << 1 | bit_vector_get(iml.lsb, x));
+        ck_assert_uint_eq(pl.pixels[x], color);
+        ck_assert_uint_eq(pl.opacity[x], bit_vector_get(iml.opacity, x));
+    }
+}
+
+/**
+ * @brief Unpacks an image line into a line of a framebuffer, through an image
+ */
+static void to_pixel_line(framebuffer_t* fb, size_t y, image_line_t iml)
+{
+    image_t image;
+    ck_assert_err_none(image_create(&image, WIDTH, 1));
+    ck_assert_err_none(image_set_line(&image, 0, iml));
+    const pixel_line_t from = framebuffer_line(image_framebuffer(&image), 0);
+    const pixel_line_t to = framebuffer_line(fb, y);
+    memcpy(to.pixels, from.pixels, WIDTH);
+    memcpy(to.opacity, from.opacity, WIDTH);
+    image_free(&image);
+}
+
+START_TEST(framebuffer_create_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    framebuffer_t fb;
+    ck_assert_bad_param(framebuffer_create(NULL, WIDTH, HEIGHT));
+    ck_assert_bad_param(framebuffer_create(&fb, 0, HEIGHT));
+    ck_assert_bad_param(framebuffer_create(&fb, WIDTH, 0));
+
+    ck_assert_err_none(framebuffer_create(&fb, WIDTH, HEIGHT));
+    ck_assert_uint_eq(fb.stride % FRAMEBUFFER_ALIGN, 0);
+    ck_assert_uint_ge(fb.stride, WIDTH);
+    for (size_t y = 0; y < HEIGHT; ++y)
+    {
+        const pixel_line_t line = framebuffer_line(&fb, y);
+        ck_assert_uint_eq((uintptr_t)line.pixels % FRAMEBUFFER_ALIGN, 0);
+        ck_assert_uint_eq((uintptr_t)line.opacity % FRAMEBUFFER_ALIGN, 0);
+        for (size_t x = 0; x < WIDTH; ++x)
+        {
+            ck_assert_uint_eq(line.pixels[x], 0);
+            ck_assert_uint_eq(line.opacity[x], 0);
+        }
+    }
+    framebuffer_free(&fb);
+    ck_assert_ptr_null(fb.pixels);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(image_get_pixel_from_framebuffer)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    image_t image;
+    ck_assert_err_none(image_create(&image, WIDTH, HEIGHT));
+    ck_assert_ptr_nonnull(image_framebuffer(&image));
+
+    for (size_t y = 0; y < HEIGHT; ++y)
+    {
+        image_line_t iml;
+        random_image_line(&iml);
+        assert_same_line(framebuffer_line(image_framebuffer(&image), y), image.content[y]);
+        ck_assert_err_none(image_set_line(&image, y, iml));
+        assert_same_line(framebuffer_line(image_framebuffer(&image), y), iml);
+        for (size_t x = 0; x < WIDTH; ++x)
+        {
+            uint8_t pixel = 0;
+            ck_assert_err_none(image_get_pixel(&pixel, &image, x, y));
+            ck_assert_uint_eq(pixel, bit_vector_get(iml.msb, x) << 1 | bit_vector_get(iml.lsb, x));
+        }
+        image_line_free(&iml);
+    }
+    uint8_t pixel = 0;
+    ck_assert_bad_param(image_get_pixel(&pixel, &image, WIDTH, 0));
+    ck_assert_bad_param(image_get_pixel(&pixel, &image, 0, HEIGHT));
+
+    image_free(&image);
+    ck_assert_ptr_null(image_framebuffer(&image));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(image_single_allocation)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    image_t image, copy;
+    ck_assert_err_none(image_create(&image, WIDTH, HEIGHT));
+    ck_assert_err_none(image_create(&copy, WIDTH, HEIGHT));
+    ck_assert_uint_eq((uintptr_t)image.content % FRAMEBUFFER_ALIGN, 0);
+
+    // the vectors of the lines follow each other with a fixed stride
+    const uint8_t* const first = (const uint8_t*)image.content[0].lsb;
+    const size_t stride = (size_t)((const uint8_t*)image.content[0].msb - first);
+    for (size_t y = 0; y < HEIGHT; ++y)
+    {
+        ck_assert_ptr_eq(image.content[y].lsb, first + 3 * y * stride);
+        ck_assert_ptr_eq(image.content[y].msb, first + (3 * y + 1) * stride);
+        ck_assert_ptr_eq(image.content[y].opacity, first + (3 * y + 2) * stride);
+        ck_assert_uint_eq(image.content[y].msb->size, WIDTH);
+
+        image_line_t iml;
+        random_image_line(&iml);
+        ck_assert_err_none(image_own_line_content(&image, y, iml));
+    }
+
+    ck_assert_err_none(image_copy(&copy, &image));
+    for (size_t y = 0; y < HEIGHT; ++y)
+    {
+        assert_same_line(framebuffer_line(image_framebuffer(&copy), y), image.content[y]);
+        assert_same_line(framebuffer_line(image_framebuffer(&copy), y), copy.content[y]);
+    }
+
+    ck_assert_err_none(image_clear(&image));
+    for (size_t y = 0; y < HEIGHT; ++y)
+    {
+        ck_assert_uint_eq(image.content[y].lsb->size, WIDTH);
+        for (size_t x = 0; x < WIDTH; ++x)
+        {
+            ck_assert_int_eq(bit_vector_get(image.content[y].opacity, x), 0);
+        }
+        assert_same_line(framebuffer_line(image_framebuffer(&image), y), image.content[y]);
+    }
+
+    image_t other;
+    ck_assert_err_none(image_create(&other, WIDTH, HEIGHT + 1));
+    ck_assert_bad_param(image_copy(&other, &image));
+    image_free(&other);
+    image_free(&copy);
+    image_free(&image);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(image_line_map_colors_all_palettes)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    image_line_t iml;
+    random_image_line(&iml);
+    for (unsigned map = 0; map <= UINT8_MAX; ++map)
+    {
+        image_line_t mapped;
+        ck_assert_err_none(image_line_map_colors(&mapped, iml, (palette_t)map));
+        for (size_t x = 0; x < WIDTH; ++x)
+        {
+            const unsigned color = bit_vector_get(iml.msb, x) << 1 | bit_vector_get(iml.lsb, x);
+            ck_assert_uint_eq(bit_vector_get(mapped.msb, x) << 1 | bit_vector_get(mapped.lsb, x),
+                              (map >> (2 * color)) & 3);
+            ck_assert_uint_eq(bit_vector_get(mapped.opacity, x), bit_vector_get(iml.opacity, x));
+        }
+        image_line_free(&mapped);
+    }
+    image_line_free(&iml);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(pixel_line_ops_match_image_line)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    framebuffer_t fb;
+    ck_assert_err_none(framebuffer_create(&fb, WIDTH, HEIGHT));
+    const pixel_line_t pl1 = framebuffer_line(&fb, 0);
+    const pixel_line_t pl2 = framebuffer_line(&fb, 1);
+    const pixel_line_t out = framebuffer_line(&fb, 2);
+    // output of the non-allocating variants, reused by all of them
+    image_line_t into;
+    ck_assert_err_none(image_line_create(&into, WIDTH));
+
+    for (int t = 0; t < NB_RANDOM_TESTS; ++t)
+    {
+        image_line_t iml1, iml2, expected;
+        random_image_line(&iml1);
+        random_image_line(&iml2);
+        to_pixel_line(&fb, 0, iml1);
+        to_pixel_line(&fb, 1, iml2);
+
+        const int64_t shift = rand() % (3 * WIDTH) - 3 * WIDTH / 2;
+        ck_assert_err_none(image_line_shift(&expected, iml1, shift));
+        ck_assert_err_none(pixel_line_shift(out, pl1, shift));
+        assert_same_line(out, expected);
+        ck_assert_err_none(image_line_shift_into(&into, iml1, shift));
+        assert_same_line(out, into);
+        image_line_free(&expected);
+
+        const int64_t index = rand() % (3 * WIDTH) - 3 * WIDTH / 2;
+        ck_assert_err_none(image_line_extract_wrap_ext(&expected, iml1, index, WIDTH));
+        ck_assert_err_none(pixel_line_extract_wrap(out, pl1, index));
+        assert_same_line(out, expected);
+        ck_assert_err_none(image_line_extract_wrap_ext_into(&into, iml1, index));
+        assert_same_line(out, into);
+        image_line_free(&expected);
+
+        const palette_t map = (palette_t)rand();
+        ck_assert_err_none(image_line_map_colors(&expected, iml1, map));
+        ck_assert_err_none(pixel_line_map_colors(out, pl1, map));
+        assert_same_line(out, expected);
+        ck_assert_err_none(image_line_map_colors_into(&into, iml1, map));
+        assert_same_line(out, into);
+        image_line_free(&expected);
+
+        ck_assert_err_none(image_line_below(&expected, iml1, iml2));
+        ck_assert_err_none(pixel_line_below(out, pl1, pl2));
+        assert_same_line(out, expected);
+        ck_assert_err_none(image_line_below_into(&into, iml1, iml2));
+        assert_same_line(out, into);
+        image_line_free(&expected);
+
+        const int64_t start = rand() % WIDTH;
+        ck_assert_err_none(image_line_join(&expected, iml1, iml2, start));
+        ck_assert_err_none(pixel_line_join(out, pl1, pl2, start));
+        assert_same_line(out, expected);
+        ck_assert_err_none(image_line_join_into(&into, iml1, iml2, start));
+        assert_same_line(out, into);
+        image_line_free(&expected);
+
+        // in place, the output being the first input
+        ck_assert_err_none(pixel_line_below(out, pl1, pl2));
+        ck_assert_err_none(image_line_below_into(&iml1, iml1, iml2));
+        assert_same_line(out, iml1);
+        ck_assert_err_none(pixel_line_map_colors(out, out, map));
+        ck_assert_err_none(image_line_map_colors_into(&iml1, iml1, map));
+        assert_same_line(out, iml1);
+        ck_assert_err_none(pixel_line_join(out, out, pl2, start));
+        ck_assert_err_none(image_line_join_into(&iml1, iml1, iml2, start));
+        assert_same_line(out, iml1);
+
+        image_line_free(&iml1);
+        image_line_free(&iml2);
+    }
+
+    ck_assert_bad_param(image_line_shift_into(&into, into, 1));
+    image_line_t smaller;
+    ck_assert_err_none(image_line_create(&smaller, WIDTH / 2));
+    ck_assert_bad_param(image_line_join_into(&smaller, into, into, 1));
+    ck_assert_err_none(image_line_extract_wrap_ext_into(&smaller, into, -1));
+    image_line_free(&smaller);
+    image_line_free(&into);
+
+    ck_assert_bad_param(pixel_line_shift(pl1, pl1, 1));
+    ck_assert_bad_param(pixel_line_join(out, pl1, pl2, WIDTH));
+    framebuffer_free(&fb);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(pixel_row_unpack_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    for (unsigned msb = 0; msb <= UINT8_MAX; ++msb)
+    {
+        for (unsigned lsb = 0; lsb <= UINT8_MAX; ++lsb)
+        {
+            uint8_t pixels[8];
+            pixel_row_unpack(pixels, (uint8_t)msb, (uint8_t)lsb);
+            for (size_t x = 0; x < 8; ++x)
+            {
+                ck_assert_uint_eq(pixels[x], ((msb >> x) & 1) << 1 | ((lsb >> x) & 1));
+            }
+        }
+    }
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(pixel_line_pack_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    // with and without a partial last word
+    const size_t sizes[] = { WIDTH, WIDTH - 3, 1 };
+    uint8_t pixels[WIDTH];
+    uint8_t opacity[WIDTH];
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        const pixel_line_t line = { pixels, opacity, sizes[s] };
+        for (int t = 0; t < NB_RANDOM_TESTS; ++t)
+        {
+            for (size_t x = 0; x < line.size; ++x)
+            {
+                pixels[x] = (uint8_t)(rand() & 3);
+                opacity[x] = (uint8_t)(rand() & 1);
+            }
+            uint32_t msb[WIDTH / IMAGE_LINE_WORD_BITS];
+            uint32_t lsb[WIDTH / IMAGE_LINE_WORD_BITS];
+            uint32_t opaque[WIDTH / IMAGE_LINE_WORD_BITS];
+            ck_assert_err_none(pixel_line_pack(line, msb, lsb, opaque));
+            for (size_t x = 0; x < (line.size + 31) / 32 * 32; ++x)
+            {
+                const uint32_t bit = UINT32_C(1) << (x % 32);
+                const size_t i = x / 32;
+                ck_assert_uint_eq((msb[i] & bit) != 0, x < line.size && (pixels[x] >> 1));
+                ck_assert_uint_eq((lsb[i] & bit) != 0, x < line.size && (pixels[x] & 1));
+                ck_assert_uint_eq((opaque[i] & bit) != 0, x < line.size && opacity[x]);
+            }
+        }
+    }
+
+    // through an image, back to the same pixels
+    image_t image;
+    ck_assert_err_none(image_create(&image, WIDTH, HEIGHT));
+    const pixel_line_t line = { pixels, opacity, WIDTH };
+    for (size_t y = 0; y < HEIGHT; ++y)
+    {
+        for (size_t x = 0; x < WIDTH; ++x)
+        {
+            pixels[x] = (uint8_t)(rand() & 3);
+            opacity[x] = (uint8_t)(rand() & 1);
+        }
+        ck_assert_err_none(image_set_pixel_line(&image, y, line));
+        const pixel_line_t stored = framebuffer_line(image_framebuffer(&image), y);
+        ck_assert_int_eq(memcmp(stored.pixels, pixels, WIDTH), 0);
+        ck_assert_int_eq(memcmp(stored.opacity, opacity, WIDTH), 0);
+        assert_same_line(stored, image.content[y]);
+    }
+    ck_assert_bad_param(image_set_pixel_line(&image, HEIGHT, line));
+    const pixel_line_t shorter = { pixels, opacity, WIDTH - 1 };
+    ck_assert_bad_param(image_set_pixel_line(&image, 0, shorter));
+    image_free(&image);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(framebuffer_to_rgb_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    framebuffer_t fb;
+    ck_assert_err_none(framebuffer_create(&fb, WIDTH, HEIGHT));
+    for (size_t y = 0; y < HEIGHT; ++y)
+    {
+        for (size_t x = 0; x < WIDTH; ++x)
+        {
+            framebuffer_pixel(&fb, x, y) = (uint8_t)(rand() & 3);
+        }
+    }
+    const framebuffer_shades_t grey = FRAMEBUFFER_GREY_SHADES;
+    const framebuffer_shades_t colors = { { { 1, 2, 3, 4 }, { 5, 6, 7, 8 }, { 9, 10, 11, 12 }, { 13, 14, 15, 16 } } };
+
+    // a guard byte past each row, which must be left untouched
+    static uint8_t output[HEIGHT][WIDTH * FRAMEBUFFER_RGBA + 1];
+    const size_t sizes[] = { FRAMEBUFFER_RGB, FRAMEBUFFER_RGBA };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        const size_t size = sizes[s];
+        memset(output, 0xA5, sizeof(output));
+        ck_assert_err_none(framebuffer_to_rgb(&fb, &colors, size, &output[0][0], sizeof(output[0])));
+        for (size_t y = 0; y < HEIGHT; ++y)
+        {
+            for (size_t x = 0; x < WIDTH; ++x)
+            {
+                ck_assert_int_eq(memcmp(&output[y][size * x], colors.rgba[framebuffer_pixel(&fb, x, y)], size), 0);
+            }
+            ck_assert_uint_eq(output[y][size * WIDTH], 0xA5);
+        }
+
+        ck_assert_err_none(framebuffer_to_rgb(&fb, &grey, size, &output[0][0], size * WIDTH));
+        for (size_t x = 0; x < WIDTH; ++x)
+        {
+            ck_assert_uint_eq(output[0][size * x], 255 - 85 * framebuffer_pixel(&fb, x, 0));
+        }
+    }
+
+    ck_assert_bad_param(framebuffer_to_rgb(NULL, &grey, FRAMEBUFFER_RGB, &output[0][0], sizeof(output[0])));
+    ck_assert_bad_param(framebuffer_to_rgb(&fb, NULL, FRAMEBUFFER_RGB, &output[0][0], sizeof(output[0])));
+    ck_assert_bad_param(framebuffer_to_rgb(&fb, &grey, FRAMEBUFFER_RGB, NULL, sizeof(output[0])));
+    ck_assert_bad_param(framebuffer_to_rgb(&fb, &grey, 2, &output[0][0], sizeof(output[0])));
+    ck_assert_bad_param(framebuffer_to_rgb(&fb, &grey, FRAMEBUFFER_RGBA, &output[0][0], FRAMEBUFFER_RGB * WIDTH));
+    framebuffer_free(&fb);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+Suite* framebuffer_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("framebuffer.c Tests");
+
+    Add_Case(s, tc1, "Framebuffer Tests");
+    tcase_add_test(tc1, framebuffer_create_exec);
+    tcase_add_test(tc1, image_get_pixel_from_framebuffer);
+    tcase_add_test(tc1, image_single_allocation);
+    tcase_add_test(tc1, image_line_map_colors_all_palettes);
+    tcase_add_test(tc1, pixel_line_ops_match_image_line);
+    tcase_add_test(tc1, pixel_row_unpack_exec);
+    tcase_add_test(tc1, pixel_line_pack_exec);
+    tcase_add_test(tc1, framebuffer_to_rgb_exec);
+
+    return s;
+}
+
+TEST_SUITE(framebuffer_test_suite)
@@ -0,0 +1,109 @@
+/**
+ * @file unit-test-hash.c
+ * @brief Unit test code for the 64-bit hash and the framebuffer hash
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "hash.h"
+#include "framebuffer.h"
+
+#define WIDTH 160
+#define HEIGHT 144
+
+// ======================================================================
+START_TEST(hash64_reference_values)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    uint8_t bytes[100];
+    for (size_t i = 0; i < sizeof(bytes); ++i) {
+        bytes[i] = (uint8_t) i;
+    }
+
+    // values of the reference XXH64 implementation
+    ck_assert_uint_eq(hash64("", 0, 0), UINT64_C(0xEF46DB3751D8E999));
+    ck_assert_uint_eq(hash64("abc", 3, 0), UINT64_C(0x44BC2CF5AD770999));
+    ck_assert_uint_eq(hash64(bytes, sizeof(bytes), 12345), UINT64_C(0x028BA1AE2DE4DE27));
+
+    // every kind of tail (8, 4 and 1 bytes), with and without stripes
+    const struct {
+        size_t size;
+        uint64_t hash;
+    } seeded[] = {
+        { 1,  UINT64_C(0xD90DF86C76F52E13) }, { 3,  UINT64_C(0x5AB1230478CA6310) },
+        { 4,  UINT64_C(0x6AE497162D0610D7) }, { 7,  UINT64_C(0x54640963B8C77FA9) },
+        { 8,  UINT64_C(0x3072F8C5CBA43E9A) }, { 12, UINT64_C(0x17D8629FD1DF6544) },
+        { 31, UINT64_C(0x0BDBBCAEAD6C6E56) }, { 32, UINT64_C(0xA5972D57C4AEA230) },
+        { 33, UINT64_C(0x0C43E57754C778D9) }, { 63, UINT64_C(0x379EEAB4056E3988) },
+        { 64, UINT64_C(0x3C65D1809A38A9BF) }, { 65, UINT64_C(0x68DC3663487EB225) },
+        { 99, UINT64_C(0x5AB5966CDDF7B0C0) }
+    };
+    for (size_t i = 0; i < sizeof(seeded) / sizeof(seeded[0]); ++i) {
+        ck_assert_uint_eq(hash64(bytes, seeded[i].size, 7), seeded[i].hash);
+    }
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+START_TEST(framebuffer_hash_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    framebuffer_t fb;
+    ck_assert_err_none(framebuffer_create(&fb, WIDTH, HEIGHT));
+    const uint64_t blank = framebuffer_hash(&fb);
+
+    // the opacity and the padding of the lines are not hashed
+    memset(fb.opacity, 1, fb.stride * HEIGHT);
+    fb.pixels[WIDTH] = 3;
+    ck_assert_uint_eq(framebuffer_hash(&fb), blank);
+
+    // any pixel changes it
+    framebuffer_pixel(&fb, WIDTH - 1, HEIGHT - 1) = 1;
+    const uint64_t last = framebuffer_hash(&fb);
+    ck_assert_uint_ne(last, blank);
+    framebuffer_pixel(&fb, WIDTH - 1, HEIGHT - 1) = 0;
+    framebuffer_pixel(&fb, 0, 1) = 1;
+    ck_assert_uint_ne(framebuffer_hash(&fb), blank);
+    ck_assert_uint_ne(framebuffer_hash(&fb), last);
+    framebuffer_pixel(&fb, 0, 1) = 0;
+    ck_assert_uint_eq(framebuffer_hash(&fb), blank);
+
+    framebuffer_free(&fb);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+Suite* hash_test_suite()
+{
+    Suite* s = suite_create("hash.c Tests");
+
+    Add_Case(s, tc1, "Hash Tests");
+    tcase_add_test(tc1, hash64_reference_values);
+    tcase_add_test(tc1, framebuffer_hash_exec);
+
+    return s;
+}
+
+TEST_SUITE(hash_test_suite)
@@ -0,0 +1,238 @@
+/**
+ * @file unit-test-scale.c
+ * @brief Unit test code for the integer upscaling and the pixel-art filters
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "scale.h"
+
+#define MAX_WIDTH 40
+#define MAX_HEIGHT 3
+#define FILTER_WIDTH 160
+#define FILTER_HEIGHT 9
+#define NB_RANDOM_TESTS 16
+// (LARGE_WIDTH * 2) * (LARGE_HEIGHT * 2): 2 bands of SCALE_MIN_BAND_PIXELS with Scale2x
+#define LARGE_WIDTH 1024
+#define LARGE_HEIGHT 512
+
+// ======================================================================
+START_TEST(scale_nearest_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    // a guard byte past each row, which must be left untouched
+    static uint8_t input[MAX_HEIGHT][MAX_WIDTH * SCALE_MAX_BYTES_PER_PIXEL];
+    static uint8_t output[MAX_HEIGHT * SCALE_MAX_FACTOR][MAX_WIDTH * SCALE_MAX_BYTES_PER_PIXEL * SCALE_MAX_FACTOR + 1];
+    for (size_t y = 0; y < MAX_HEIGHT; ++y)
+    {
+        for (size_t i = 0; i < sizeof(input[y]); ++i)
+        {
+            input[y][i] = (uint8_t) rand();
+        }
+    }
+
+    // every factor and pixel size, widths with and without a short tail
+    const size_t widths[] = { 1, 5, 17, MAX_WIDTH };
+    for (size_t bpp = 1; bpp <= SCALE_MAX_BYTES_PER_PIXEL; ++bpp)
+    {
+        for (size_t factor = 1; factor <= SCALE_MAX_FACTOR; ++factor)
+        {
+            for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+            {
+                const size_t width = widths[w];
+                const pixmap_t in = { &input[0][0], width, MAX_HEIGHT, sizeof(input[0]), bpp };
+                const pixmap_t out = { &output[0][0], width * factor, MAX_HEIGHT * factor, sizeof(output[0]), bpp };
+                memset(output, 0xA5, sizeof(output));
+                ck_assert_err_none(scale_nearest(&out, &in, factor));
+                for (size_t y = 0; y < out.height; ++y)
+                {
+                    for (size_t x = 0; x < out.width; ++x)
+                    {
+                        ck_assert_int_eq(memcmp(&output[y][x * bpp], &input[y / factor][x / factor * bpp], bpp), 0);
+                    }
+                    ck_assert_uint_eq(output[y][out.width * bpp], 0xA5);
+                }
+            }
+        }
+    }
+
+    const pixmap_t in = { &input[0][0], MAX_WIDTH, MAX_HEIGHT, sizeof(input[0]), 3 };
+    pixmap_t out = { &output[0][0], MAX_WIDTH * 2, MAX_HEIGHT * 2, sizeof(output[0]), 3 };
+    ck_assert_bad_param(scale_nearest(NULL, &in, 2));
+    ck_assert_bad_param(scale_nearest(&out, NULL, 2));
+    ck_assert_bad_param(scale_nearest(&out, &in, 0));
+    ck_assert_bad_param(scale_nearest(&out, &in, 3));
+    out.bytes_per_pixel = 4;
+    ck_assert_bad_param(scale_nearest(&out, &in, 2));
+    out.bytes_per_pixel = 3;
+    out.stride = MAX_WIDTH;
+    ck_assert_bad_param(scale_nearest(&out, &in, 2));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// reference filters, from the AdvanceMAME description
+static uint8_t reference_filter(const uint8_t* input, size_t stride, size_t width, size_t height,
+                                scale_filter_t filter, size_t x, size_t y)
+{
+    const size_t factor = (size_t) filter;
+    const size_t px = x / factor;
+    const size_t py = y / factor;
+    const size_t left = px > 0 ? px - 1 : px;
+    const size_t right = px + 1 < width ? px + 1 : px;
+    const size_t up = py > 0 ? py - 1 : py;
+    const size_t down = py + 1 < height ? py + 1 : py;
+#define P(i, j) input[(j) * stride + (i)]
+    const uint8_t A = P(left, up), B = P(px, up), C = P(right, up);
+    const uint8_t D = P(left, py), E = P(px, py), F = P(right, py);
+    const uint8_t G = P(left, down), H = P(px, down), I = P(right, down);
+#undef P
+    const size_t sub = (y % factor) * factor + x % factor;
+    if (filter == SCALE_SCALE2X)
+    {
+        const uint8_t e[4] = {
+            D == B && B != F && D != H ? D : E,
+            B == F && B != D && F != H ? F : E,
+            D == H && D != B && H != F ? D : E,
+            H == F && D != H && B != F ? F : E
+        };
+        return e[sub];
+    }
+    if (filter == SCALE_SCALE3X)
+    {
+        const uint8_t e[9] = {
+            D == B && B != F && D != H ? D : E,
+            (D == B && B != F && D != H && E != C) || (B == F && B != D && F != H && E != A) ? B : E,
+            B == F && B != D && F != H ? F : E,
+            (D == B && B != F && D != H && E != G) || (D == H && D != B && H != F && E != A) ? D : E,
+            E,
+            (B == F && B != D && F != H && E != I) || (H == F && D != H && B != F && E != C) ? F : E,
+            D == H && D != B && H != F ? D : E,
+            (D == H && D != B && H != F && E != I) || (H == F && D != H && B != F && E != G) ? H : E,
+            H == F && D != H && B != F ? F : E
+        };
+        return e[sub];
+    }
+    return E;
+}
+
+START_TEST(scale_filter_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    static uint8_t input[FILTER_HEIGHT][FILTER_WIDTH];
+    static uint8_t output[FILTER_HEIGHT * 3][FILTER_WIDTH * 3 + 1];
+
+    // widths with and without vectors, and short tails
+    const size_t widths[] = { 1, 2, 17, 18, 50, FILTER_WIDTH };
+    const size_t heights[] = { 1, 2, FILTER_HEIGHT };
+    const scale_filter_t filters[] = { SCALE_NONE, SCALE_SCALE2X, SCALE_SCALE3X };
+    for (int t = 0; t < NB_RANDOM_TESTS; ++t)
+    {
+        // few colors, for many edges
+        for (size_t y = 0; y < FILTER_HEIGHT; ++y)
+        {
+            for (size_t x = 0; x < FILTER_WIDTH; ++x)
+            {
+                input[y][x] = (uint8_t) (rand() & 3);
+            }
+        }
+        for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+        {
+            const size_t factor = (size_t) filters[f];
+            for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+            {
+                for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); ++h)
+                {
+                    const size_t width = widths[w];
+                    const size_t height = heights[h];
+                    const size_t nb_threads = (size_t) (1 + (w + h + (size_t) t) % 4);
+                    const pixmap_t in = { &input[0][0], width, height, sizeof(input[0]), 1 };
+                    const pixmap_t out = { &output[0][0], width * factor, height * factor, sizeof(output[0]), 1 };
+                    memset(output, 0xA5, sizeof(output));
+                    ck_assert_err_none(scale_filter(&out, &in, filters[f], nb_threads));
+                    for (size_t y = 0; y < out.height; ++y)
+                    {
+                        for (size_t x = 0; x < out.width; ++x)
+                        {
+                            ck_assert_uint_eq(output[y][x],
+                                              reference_filter(&input[0][0], sizeof(input[0]), width, height,
+                                                               filters[f], x, y));
+                        }
+                        ck_assert_uint_eq(output[y][out.width], 0xA5);
+                    }
+                }
+            }
+        }
+    }
+
+    // large enough for bands on threads, which must give the same pixels
+    static uint8_t large_input[LARGE_HEIGHT][LARGE_WIDTH];
+    static uint8_t large_output[2][LARGE_HEIGHT * 3][LARGE_WIDTH * 3];
+    for (size_t y = 0; y < LARGE_HEIGHT; ++y)
+    {
+        for (size_t x = 0; x < LARGE_WIDTH; ++x)
+        {
+            large_input[y][x] = (uint8_t) (rand() & 3);
+        }
+    }
+    for (size_t f = 1; f < sizeof(filters) / sizeof(filters[0]); ++f)
+    {
+        const size_t factor = (size_t) filters[f];
+        const pixmap_t in = { &large_input[0][0], LARGE_WIDTH, LARGE_HEIGHT, sizeof(large_input[0]), 1 };
+        const pixmap_t one = { &large_output[0][0][0], LARGE_WIDTH * factor, LARGE_HEIGHT * factor,
+                               sizeof(large_output[0][0]), 1 };
+        const pixmap_t many = { &large_output[1][0][0], LARGE_WIDTH * factor, LARGE_HEIGHT * factor,
+                                sizeof(large_output[1][0]), 1 };
+        ck_assert_err_none(scale_filter(&one, &in, filters[f], 1));
+        ck_assert_err_none(scale_filter(&many, &in, filters[f], SCALE_MAX_THREADS));
+        ck_assert_int_eq(memcmp(large_output[0], large_output[1], sizeof(large_output[0])), 0);
+    }
+
+    const pixmap_t in = { &input[0][0], FILTER_WIDTH, FILTER_HEIGHT, sizeof(input[0]), 1 };
+    pixmap_t out = { &output[0][0], FILTER_WIDTH * 2, FILTER_HEIGHT * 2, sizeof(output[0]), 1 };
+    ck_assert_bad_param(scale_filter(NULL, &in, SCALE_SCALE2X, 1));
+    ck_assert_bad_param(scale_filter(&out, NULL, SCALE_SCALE2X, 1));
+    ck_assert_bad_param(scale_filter(&out, &in, SCALE_SCALE3X, 1));
+    ck_assert_bad_param(scale_filter(&out, &in, (scale_filter_t) 4, 1));
+    ck_assert_bad_param(scale_filter(&out, &in, SCALE_SCALE2X, 0));
+    ck_assert_bad_param(scale_filter(&out, &in, SCALE_SCALE2X, SCALE_MAX_THREADS + 1));
+    out.bytes_per_pixel = 3;
+    ck_assert_bad_param(scale_filter(&out, &in, SCALE_SCALE2X, 1));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+Suite* scale_test_suite()
+{
+    Suite* s = suite_create("scale.c Tests");
+
+    Add_Case(s, tc1, "Scale Tests");
+    tcase_add_test(tc1, scale_nearest_exec);
+    tcase_add_test(tc1, scale_filter_exec);
+
+    return s;
+}
+
+TEST_SUITE(scale_test_suite)
@@ -0,0 +1,139 @@
+/**
+ * @file unit-test-spsc_queue.c
+ * @brief Unit test code for the lock-free queue between two threads
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "spsc_queue.h"
+#include "error.h"
+
+#define CAPACITY 16
+#define NB_THREADED_ENTRIES 1000000
+
+// ======================================================================
+START_TEST(spsc_queue_init_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    spsc_queue_t queue;
+
+    ck_assert_bad_param(spsc_queue_init(NULL, CAPACITY));
+    ck_assert_bad_param(spsc_queue_init(&queue, 0));
+    ck_assert_bad_param(spsc_queue_init(&queue, 12));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+START_TEST(spsc_queue_push_pop_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    spsc_queue_t queue;
+    ck_assert_err_none(spsc_queue_init(&queue, CAPACITY));
+
+    uint32_t entry = 0;
+    ck_assert(!spsc_queue_pop(&queue, &entry));
+
+    // several rounds, for the indices to wrap around the ring
+    uint32_t next = 0;
+    for (uint32_t round = 0; round < 5; ++round) {
+        for (uint32_t i = 0; i < CAPACITY; ++i) {
+            ck_assert(spsc_queue_push(&queue, next + i));
+        }
+        ck_assert(!spsc_queue_push(&queue, 0));
+
+        for (uint32_t i = 0; i < CAPACITY / 2 + round; ++i) {
+            ck_assert(spsc_queue_pop(&queue, &entry));
+            ck_assert_uint_eq(entry, next++);
+        }
+        while (spsc_queue_pop(&queue, &entry)) {
+            ck_assert_uint_eq(entry, next++);
+        }
+        next = next * 3 + 1;
+    }
+
+    spsc_queue_free(&queue);
+    ck_assert_ptr_null(queue.entries);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+static void* produce(void* arg)
+{
+    spsc_queue_t* const queue = arg;
+    for (uint32_t i = 0; i < NB_THREADED_ENTRIES; ++i) {
+        while (!spsc_queue_push(queue, i)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+START_TEST(spsc_queue_threads_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    spsc_queue_t queue;
+    ck_assert_err_none(spsc_queue_init(&queue, CAPACITY));
+
+    pthread_t producer;
+    ck_assert_int_eq(pthread_create(&producer, NULL, produce, &queue), 0);
+
+    // the entries come out complete and in order
+    for (uint32_t i = 0; i < NB_THREADED_ENTRIES; ++i) {
+        uint32_t entry = 0;
+        while (!spsc_queue_pop(&queue, &entry)) {
+            sched_yield();
+        }
+        ck_assert_uint_eq(entry, i);
+    }
+    ck_assert_int_eq(pthread_join(producer, NULL), 0);
+
+    uint32_t entry = 0;
+    ck_assert(!spsc_queue_pop(&queue, &entry));
+    spsc_queue_free(&queue);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+Suite* spsc_queue_test_suite()
+{
+    Suite* s = suite_create("spsc_queue.c Tests");
+
+    Add_Case(s, tc1, "SPSC Queue Tests");
+    tcase_add_test(tc1, spsc_queue_init_err);
+    tcase_add_test(tc1, spsc_queue_push_pop_exec);
+    tcase_add_test(tc1, spsc_queue_threads_exec);
+
+    return s;
+}
+
+TEST_SUITE(spsc_queue_test_suite)
@@ -0,0 +1,223 @@
+/**
+ * @file unit-test-trace.c
+ * @brief Unit test code for the instruction trace
+ *
+ * @author Tancrède Guillou, Pablo Stebler
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "util.h"
+#include "tests.h"
+#include "trace.h"
+#include "cpu.h"
+#include "bus.h"
+
+#define DUMP_FILE "unit-test-trace.bin"
+#define LINE_SIZE 128
+
+#define INIT \
+    trace_t trace; \
+    cpu_t cpu; \
+    bus_t bus; \
+    data_t mem[BUS_SIZE]; \
+    zero_init_var(cpu); \
+    zero_init_var(bus); \
+    memset(mem, 0, sizeof(mem)); \
+    for (size_t i = 0; i < BUS_SIZE; ++i) bus[i] = &mem[i]; \
+    cpu.bus = &bus; \
+    ck_assert_err_none(trace_init(&trace))
+
+// ======================================================================
+/**
+ * @brief Dumps the trace and decodes it (returns the decoded text, rewound)
+ */
+static FILE* dump_and_decode(const trace_t* trace)
+{
+    ck_assert_err_none(trace_dump(trace, DUMP_FILE));
+    FILE* input = fopen(DUMP_FILE, "rb");
+    ck_assert_ptr_nonnull(input);
+    FILE* output = tmpfile();
+    ck_assert_ptr_nonnull(output);
+    ck_assert_err_none(trace_decode(input, output));
+    fclose(input);
+    remove(DUMP_FILE);
+    rewind(output);
+    return output;
+}
+
+/**
+ * @brief Decodes the trace into lines[] (returns the number of lines)
+ */
+static size_t decode_lines(const trace_t* trace, char lines[][LINE_SIZE], size_t max)
+{
+    FILE* output = dump_and_decode(trace);
+    size_t n = 0;
+    while (n < max && NULL != fgets(lines[n], LINE_SIZE, output))
+    {
+        ++n;
+    }
+    fclose(output);
+    return n;
+}
+
+START_TEST(trace_init_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    cpu_t cpu;
+    zero_init_var(cpu);
+    trace_t trace;
+    zero_init_var(trace);
+    ck_assert_bad_param(trace_init(NULL));
+    ck_assert_bad_param(trace_cycle(NULL, &cpu, 0));
+    ck_assert_bad_param(trace_cycle(&trace, &cpu, 0));
+    ck_assert_bad_param(trace_dump(&trace, DUMP_FILE));
+    ck_assert_bad_param(trace_decode(NULL, stdout));
+    trace_free(NULL);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(trace_round_trip)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+
+    // LD A, n8 ; CB SWAP A ; JP a16 at 0x0150
+    mem[0x0150] = 0x3E; mem[0x0151] = 0x42;
+    mem[0x0152] = 0xCB; mem[0x0153] = 0x37;
+    mem[0x0154] = 0xC3;
+
+    cpu.PC = 0x0150; cpu.SP = 0xFFFE; cpu.BC = 0x0013;
+    ck_assert_err_none(trace_cycle(&trace, &cpu, 100));
+    cpu.PC = 0x0152; cpu.A = 0x42;
+    ck_assert_err_none(trace_cycle(&trace, &cpu, 102));
+    // an instruction is running: nothing is recorded
+    cpu.idle_time = 1;
+    ck_assert_err_none(trace_cycle(&trace, &cpu, 103));
+    cpu.idle_time = 0;
+    cpu.PC = 0x0154; cpu.A = 0x24;
+    ck_assert_err_none(trace_cycle(&trace, &cpu, 104));
+    // jump, with an interrupt to serve
+    cpu.PC = 0x0000; cpu.IME = 1; cpu.IE = cpu.IF = 0x01;
+    ck_assert_err_none(trace_cycle(&trace, &cpu, 108));
+
+    char lines[8][LINE_SIZE];
+    ck_assert_uint_eq(decode_lines(&trace, lines, 8), 4);
+    ck_assert_str_eq(lines[0], "         100 PC=0150 OP=3E AF=0000 BC=0013 DE=0000 HL=0000 SP=FFFE\n");
+    ck_assert_str_eq(lines[1], "         102 PC=0152 OP=CB 37 AF=4200 BC=0013 DE=0000 HL=0000 SP=FFFE\n");
+    ck_assert_str_eq(lines[2], "         104 PC=0154 OP=C3 AF=2400 BC=0013 DE=0000 HL=0000 SP=FFFE\n");
+    ck_assert_str_eq(lines[3], "         108 PC=0000 OP=00 AF=2400 BC=0013 DE=0000 HL=0000 SP=FFFE INT\n");
+
+    trace_free(&trace);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(trace_halt)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+
+    cpu.HALT = 1;
+    ck_assert_err_none(trace_cycle(&trace, &cpu, 1));
+    // woken up by a pending interrupt, even with IME cleared
+    cpu.IE = cpu.IF = 0x04;
+    ck_assert_err_none(trace_cycle(&trace, &cpu, 2));
+
+    char lines[4][LINE_SIZE];
+    ck_assert_uint_eq(decode_lines(&trace, lines, 4), 1);
+    ck_assert_str_eq(lines[0], "           2 PC=0000 OP=00 AF=0000 BC=0000 DE=0000 HL=0000 SP=0000\n");
+
+    trace_free(&trace);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(trace_ring_wraps)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+
+    // every record changes PC and all the registers: enough of them to fill the ring twice
+    const size_t total = 2 * TRACE_NB_BLOCKS * TRACE_BLOCK_SIZE / 8;
+    for (size_t i = 1; i <= total; ++i)
+    {
+        cpu.PC = cpu.AF = cpu.BC = cpu.DE = cpu.HL = cpu.SP = (uint16_t)(i * 2);
+        ck_assert_err_none(trace_cycle(&trace, &cpu, i));
+    }
+
+    FILE* output = dump_and_decode(&trace);
+    char line[LINE_SIZE];
+    size_t n = 0;
+    while (NULL != fgets(line, LINE_SIZE, output))
+    {
+        ++n;
+    }
+    ck_assert_uint_lt(n, total);
+    ck_assert_uint_gt(n, total / 4);
+
+    // the most recent records are kept, in order
+    rewind(output);
+    char expected[LINE_SIZE];
+    for (size_t cycle = total - n + 1; cycle <= total; ++cycle)
+    {
+        const uint16_t value = (uint16_t)(cycle * 2);
+        snprintf(expected, LINE_SIZE, "%12zu PC=%04" PRIX16 " OP=00 AF=%04" PRIX16 " BC=%04" PRIX16
+                 " DE=%04" PRIX16 " HL=%04" PRIX16 " SP=%04" PRIX16 "\n",
+                 cycle, value, value, value, value, value, value);
+        ck_assert_ptr_nonnull(fgets(line, LINE_SIZE, output));
+        ck_assert_str_eq(line, expected);
+    }
+    fclose(output);
+
+    trace_free(&trace);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+Suite* trace_test_suite()
+{
+    Suite* s = suite_create("trace.c Tests");
+
+    Add_Case(s, tc1, "Trace Tests");
+    tcase_add_test(tc1, trace_init_err);
+    tcase_add_test(tc1, trace_round_trip);
+    tcase_add_test(tc1, trace_halt);
+    tcase_add_test(tc1, trace_ring_wraps);
+
+    return s;
+}
+
+TEST_SUITE(trace_test_suite)